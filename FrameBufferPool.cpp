@@ -0,0 +1,108 @@
+#include "FrameBufferPool.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <cstdlib>
+#ifdef Q_OS_WIN
+#include <malloc.h>
+#endif
+
+FrameBufferPool::FrameBufferPool(qint64 maxIdleBytes)
+    : m_maxIdleBytes(maxIdleBytes)
+{
+}
+
+FrameBufferPool::~FrameBufferPool() {
+    trim();
+}
+
+quint64 FrameBufferPool::key(int pitch, int lines) {
+    return (static_cast<quint64>(static_cast<quint32>(pitch)) << 32) | static_cast<quint32>(lines);
+}
+
+uchar* FrameBufferPool::allocateAligned(qint64 size) {
+    // Round up so the size is a multiple of the alignment, as required by
+    // some aligned allocators and so SIMD tails never read past the end.
+    const qint64 rounded = (std::max<qint64>(size, 1) + kAlignment - 1) & ~static_cast<qint64>(kAlignment - 1);
+#ifdef Q_OS_WIN
+    return static_cast<uchar*>(_aligned_malloc(static_cast<size_t>(rounded), kAlignment));
+#else
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, kAlignment, static_cast<size_t>(rounded)) != 0) return nullptr;
+    return static_cast<uchar*>(buffer);
+#endif
+}
+
+void FrameBufferPool::freeAligned(uchar* buffer) {
+#ifdef Q_OS_WIN
+    _aligned_free(buffer);
+#else
+    std::free(buffer);
+#endif
+}
+
+uchar* FrameBufferPool::acquire(int pitch, int lines) {
+    const qint64 size = static_cast<qint64>(pitch) * lines;
+    {
+        QMutexLocker lock(&m_mutex);
+        auto it = m_idle.find(key(pitch, lines));
+        if (it != m_idle.end() && !it->isEmpty()) {
+            uchar* buffer = it->takeLast();
+            m_bytesIdle -= size;
+            m_bytesInUse += size;
+            return buffer;
+        }
+    }
+
+    // Allocate outside the lock; a fresh 4K luma plane is ~8 MB.
+    uchar* buffer = allocateAligned(size);
+    if (!buffer) return nullptr;
+
+    QMutexLocker lock(&m_mutex);
+    m_bytesInUse += size;
+    m_highWaterBytes = std::max(m_highWaterBytes, m_bytesInUse + m_bytesIdle);
+    return buffer;
+}
+
+void FrameBufferPool::release(uchar* buffer, int pitch, int lines) {
+    if (!buffer) return;
+    const qint64 size = static_cast<qint64>(pitch) * lines;
+
+    QMutexLocker lock(&m_mutex);
+    m_bytesInUse -= size;
+    if (m_bytesIdle + size > m_maxIdleBytes) {
+        lock.unlock();
+        freeAligned(buffer);
+        return;
+    }
+    m_idle[key(pitch, lines)].append(buffer);
+    m_bytesIdle += size;
+}
+
+void FrameBufferPool::trim() {
+    QHash<quint64, QList<uchar*>> idle;
+    {
+        QMutexLocker lock(&m_mutex);
+        idle.swap(m_idle);
+        m_bytesIdle = 0;
+    }
+    for (const QList<uchar*>& buffers : std::as_const(idle)) {
+        for (uchar* buffer : buffers) {
+            freeAligned(buffer);
+        }
+    }
+}
+
+qint64 FrameBufferPool::bytesInUse() const {
+    QMutexLocker lock(&m_mutex);
+    return m_bytesInUse;
+}
+
+qint64 FrameBufferPool::bytesIdle() const {
+    QMutexLocker lock(&m_mutex);
+    return m_bytesIdle;
+}
+
+qint64 FrameBufferPool::highWaterBytes() const {
+    QMutexLocker lock(&m_mutex);
+    return m_highWaterBytes;
+}
@@ -0,0 +1,75 @@
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QtGlobal>
+
+/**
+ * @brief Pool of 64-byte aligned video plane buffers keyed by (pitch, lines)
+ *
+ * Plane memory is recycled across format renegotiations and media loads
+ * instead of being freed and re-zeroed every time. Buffers are returned
+ * uninitialised: VLC overwrites every visible byte, and the padding it asked
+ * for is never displayed.
+ *
+ * acquire() runs on VLC's video thread while release() runs on whichever
+ * thread drops the last reference to a frame (GUI or render thread), so all
+ * bookkeeping is behind a mutex. It is only taken once per plane per new
+ * picture, never per frame.
+ */
+class FrameBufferPool {
+public:
+    /** @brief Alignment of every buffer, enough for aligned AVX2/AVX-512 loads */
+    static constexpr int kAlignment = 64;
+
+    /**
+     * @brief Creates the pool
+     * @param maxIdleBytes Idle memory kept for reuse; anything above is freed
+     */
+    explicit FrameBufferPool(qint64 maxIdleBytes = 192ll * 1024 * 1024);
+    ~FrameBufferPool();
+
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    /**
+     * @brief Returns an aligned, uninitialised buffer of pitch * lines bytes
+     * @return The buffer, or nullptr if the allocation failed
+     */
+    uchar* acquire(int pitch, int lines);
+
+    /** @brief Hands a buffer obtained from acquire() back for reuse */
+    void release(uchar* buffer, int pitch, int lines);
+
+    /** @brief Frees every idle buffer */
+    void trim();
+
+    /** @brief Bytes currently handed out */
+    qint64 bytesInUse() const;
+
+    /** @brief Bytes kept idle for reuse */
+    qint64 bytesIdle() const;
+
+    /** @brief Highest total (in use + idle) seen since the pool was created */
+    qint64 highWaterBytes() const;
+
+    /** @brief Allocates aligned memory outside of any pool */
+    static uchar* allocateAligned(qint64 size);
+
+    /** @brief Frees memory from allocateAligned() */
+    static void freeAligned(uchar* buffer);
+
+private:
+    static quint64 key(int pitch, int lines);
+
+    mutable QMutex m_mutex;
+    QHash<quint64, QList<uchar*>> m_idle;
+    qint64 m_maxIdleBytes;
+    qint64 m_bytesInUse = 0;
+    qint64 m_bytesIdle = 0;
+    qint64 m_highWaterBytes = 0;
+};
+
+#endif // FRAMEBUFFERPOOL_H
@@ -0,0 +1,118 @@
+#include "FramePacer.h"
+#include <QScreen>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+FramePacer::FramePacer(QObject* parent)
+    : QObject(parent)
+{
+}
+
+qint64 FramePacer::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FramePacer::setWindow(QQuickWindow* window) {
+    if (m_window == window)
+        return;
+    if (m_window)
+        disconnect(m_window, nullptr, this, nullptr);
+    disconnect(m_swapConnection);
+    m_window = window;
+    m_pendingTimestamp.store(0, std::memory_order_relaxed);
+
+    double interval = 0.0;
+    if (window) {
+        connect(window, &QQuickWindow::afterAnimating, this, &FramePacer::onAfterAnimating);
+        // frameSwapped comes from the render thread with the threaded render
+        // loop; only atomics and the stats mutex are touched there.
+        m_swapConnection = connect(window, &QQuickWindow::frameSwapped, this,
+                                   [this]() { onFrameSwapped(); }, Qt::DirectConnection);
+        if (QScreen* screen = window->screen(); screen && screen->refreshRate() > 0)
+            interval = 1000.0 / screen->refreshRate();
+    }
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_refreshInterval = interval;
+    }
+
+    // A request made before the window was known must not get stuck.
+    if (m_requested.load(std::memory_order_acquire))
+        scheduleUpdate();
+}
+
+void FramePacer::requestFrame() {
+    if (!m_requested.exchange(true, std::memory_order_acq_rel))
+        QMetaObject::invokeMethod(this, "scheduleUpdate", Qt::QueuedConnection);
+}
+
+void FramePacer::scheduleUpdate() {
+    if (m_window && m_window->isExposed()) {
+        // afterAnimating of the frame this schedules delivers the picture.
+        m_due = true;
+        m_window->update();
+        return;
+    }
+    // Nothing is rendering, so there is no vsync to wait for.
+    m_requested.store(false, std::memory_order_release);
+    emit frameDue();
+}
+
+void FramePacer::onAfterAnimating() {
+    if (!m_due)
+        return;
+    m_due = false;
+    // Cleared before delivery so a frame published meanwhile requests the
+    // next vsync rather than being lost.
+    m_requested.store(false, std::memory_order_release);
+    emit frameDue();
+}
+
+void FramePacer::framePresented(qint64 presentationTime) {
+    if (m_window)
+        m_pendingTimestamp.store(presentationTime, std::memory_order_release);
+}
+
+void FramePacer::onFrameSwapped() {
+    const qint64 timestamp = m_pendingTimestamp.exchange(0, std::memory_order_acq_rel);
+    if (timestamp == 0)
+        return;
+    const double latency = (now() - timestamp) / 1e6;
+
+    QMutexLocker locker(&m_statsMutex);
+    m_latencyMin = m_presented == 0 ? latency : std::min(m_latencyMin, latency);
+    m_latencyMax = std::max(m_latencyMax, latency);
+    m_latencySum += latency;
+    m_latencySquares += latency * latency;
+    ++m_presented;
+    // The fastest frame shows the pipeline's fixed delay; anything a whole
+    // refresh slower than that was held back a vsync and judders.
+    if (m_refreshInterval > 0.0 && latency > m_latencyMin + m_refreshInterval)
+        ++m_late;
+}
+
+QVariantMap FramePacer::stats() const {
+    QMutexLocker locker(&m_statsMutex);
+    const double mean = m_presented ? m_latencySum / m_presented : 0.0;
+    const double variance = m_presented ? m_latencySquares / m_presented - mean * mean : 0.0;
+    QVariantMap stats;
+    stats["presented"] = static_cast<qulonglong>(m_presented);
+    stats["meanLatencyMs"] = mean;
+    stats["jitterMs"] = std::sqrt(std::max(0.0, variance));
+    stats["maxLatencyMs"] = m_latencyMax;
+    stats["lateFrames"] = static_cast<qulonglong>(m_late);
+    stats["refreshIntervalMs"] = m_refreshInterval;
+    return stats;
+}
+
+void FramePacer::reset() {
+    QMutexLocker locker(&m_statsMutex);
+    m_presented = 0;
+    m_late = 0;
+    m_latencySum = 0.0;
+    m_latencySquares = 0.0;
+    m_latencyMin = 0.0;
+    m_latencyMax = 0.0;
+}
@@ -0,0 +1,95 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <QObject>
+#include <QMutex>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QVariantMap>
+#include <atomic>
+
+/**
+ * @brief Releases decoded frames to the scene graph in step with vsync
+ *
+ * The decoder side calls requestFrame() whenever a picture is ready. Instead
+ * of delivering straight away, the pacer asks the window for a frame and
+ * emits frameDue() from QQuickWindow::afterAnimating, right before the scene
+ * graph synchronises, so a frame set on the sink in response is always shown
+ * at the very next swap. Without a window it falls back to delivering from a
+ * queued call.
+ *
+ * Every delivered frame's presentation timestamp is matched against the
+ * following QQuickWindow::frameSwapped to measure when it actually reached
+ * the screen; stats() summarises that latency and its jitter.
+ */
+class FramePacer : public QObject {
+    Q_OBJECT
+
+public:
+    explicit FramePacer(QObject* parent = nullptr);
+
+    /** @brief Current steady-clock time in nanoseconds, the timestamp base */
+    static qint64 now();
+
+    /**
+     * @brief Sets the window whose vsync drives delivery (GUI thread)
+     * @param window Window showing the video, or nullptr to deliver unpaced
+     */
+    void setWindow(QQuickWindow* window);
+
+    /**
+     * @brief Asks for frameDue() at the next vsync (any thread)
+     *
+     * Calls made before that frameDue() fire are coalesced into one.
+     */
+    void requestFrame();
+
+    /**
+     * @brief Records that a frame with the given timestamp went to the sink
+     * @param presentationTime now()-based time the frame was due (GUI thread)
+     */
+    void framePresented(qint64 presentationTime);
+
+    /**
+     * @brief Pacing statistics since the last reset()
+     *
+     * Keys: presented, meanLatencyMs, jitterMs, maxLatencyMs, lateFrames
+     * (reached the screen more than one refresh after the fastest frame) and
+     * refreshIntervalMs.
+     */
+    QVariantMap stats() const;
+
+    /** @brief Clears the statistics, e.g. when a new video starts */
+    void reset();
+
+signals:
+    /** @brief The scene graph is about to sync; deliver the newest frame now */
+    void frameDue();
+
+private slots:
+    void scheduleUpdate();
+    void onAfterAnimating();
+
+private:
+    // Render thread (or GUI thread with the basic render loop).
+    void onFrameSwapped();
+
+    QPointer<QQuickWindow> m_window;
+    QMetaObject::Connection m_swapConnection;
+    std::atomic<bool> m_requested{ false };
+    bool m_due = false;
+    // Timestamp of the frame handed to the sink in this sync, 0 if none.
+    // Written on the GUI thread, consumed by the following frameSwapped.
+    std::atomic<qint64> m_pendingTimestamp{ 0 };
+
+    mutable QMutex m_statsMutex;
+    quint64 m_presented = 0;
+    quint64 m_late = 0;
+    double m_latencySum = 0.0;       // ms
+    double m_latencySquares = 0.0;   // ms²
+    double m_latencyMin = 0.0;       // ms
+    double m_latencyMax = 0.0;       // ms
+    double m_refreshInterval = 0.0;  // ms, 0 until the window is known
+};
+
+#endif // FRAMEPACER_H
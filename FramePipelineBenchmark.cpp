@@ -0,0 +1,358 @@
+/**
+ * @file FramePipelineBenchmark.cpp
+ * @brief Headless benchmark of the decode → sink frame path
+ *
+ * Drives VLCPlayerHandler's libVLC video callbacks and deliverFrame()
+ * against a bare QVideoSink. The sink has no RHI, so frames take the CPU
+ * BGRA path, which is the one whose cost varies with every change to the
+ * converter. Runs synthetic I420 (or I0AL) frames at 720p, 1080p and 4K,
+ * and optionally a local clip played through libVLC.
+ *
+ * Usage:
+ *   FramePipelineBenchmark [--frames N] [--10bit] [--output WxH]
+ *                          [--clip PATH|file://URL] [--seconds S] [--variants]
+ *
+ * --output pretends the video item is WxH physical pixels, so frames are
+ * scaled down on delivery as they would be in a window that size. A clip
+ * plays in real time, so its fps shows whether delivery kept up rather than
+ * raw throughput; the synthetic runs go as fast as the pipeline allows.
+ *
+ * --variants also times the colour converter alone on a 4K picture for
+ * every kernel × matrix (BT.601/709/2020) × range (limited/full), each
+ * against that kernel's BT.601 limited-range conversion, the fixed path
+ * the specialised kernels replaced.
+ *
+ * The handler runs headless on default settings, so a run leaves the
+ * user's journal, caches and conf.ini alone and sends nothing to a server.
+ */
+
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QUrl>
+#include <QVideoSink>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "VLCPlayerHandler.h"
+
+/**
+ * @brief Times each stage of the frame path around the real callbacks
+ *
+ * Installed as the libVLC callbacks in place of the handler's own; every
+ * wrapper forwards to the VLCPlayerHandler implementation.
+ */
+class FramePipelineBenchmark {
+public:
+    FramePipelineBenchmark(VLCPlayerHandler& handler, QVideoSink& sink)
+        : m_handler(handler)
+    {
+        QObject::connect(&sink, &QVideoSink::videoFrameChanged, &sink, [this]() { ++m_sinkFrames; });
+        // Time deliverFrame() as the pacer invokes it.
+        QObject::disconnect(&m_handler.m_framePacer, &FramePacer::frameDue, &m_handler, nullptr);
+        QObject::connect(&m_handler.m_framePacer, &FramePacer::frameDue, &m_handler, [this]() { deliver(); });
+    }
+
+    /** @brief Decodes `frames` synthetic pictures of the given size and reports */
+    void runSynthetic(const char* name, int width, int height, int bitDepth, int frames) {
+        reset();
+        char chroma[5] = { 0 };
+        std::memcpy(chroma, bitDepth > 8 ? "I0AL" : "I420", 4);
+        unsigned w = static_cast<unsigned>(width);
+        unsigned h = static_cast<unsigned>(height);
+        unsigned pitches[3] = { 0, 0, 0 };
+        unsigned lines[3] = { 0, 0, 0 };
+        void* opaque = this;
+        formatCallback(&opaque, chroma, &w, &h, pitches, lines);
+
+        // One pre-rendered picture stands in for the decoder's output.
+        std::vector<uint8_t> source[3];
+        for (int i = 0; i < 3; ++i) {
+            source[i].resize(static_cast<size_t>(pitches[i]) * lines[i]);
+            fillPlane(source[i], pitches[i], lines[i], bitDepth, i == 0 ? 16 : 128);
+        }
+
+        QElapsedTimer wall;
+        wall.start();
+        for (int n = 0; n < frames; ++n) {
+            void* planes[3] = { nullptr, nullptr, nullptr };
+            void* picture = lockCallback(this, planes);
+            for (int i = 0; i < 3; ++i) std::memcpy(planes[i], source[i].data(), source[i].size());
+            unlockCallback(this, picture, planes);
+            displayCallback(this, picture);
+            // No window is attached, so the pacer delivers from the event loop.
+            QCoreApplication::processEvents();
+        }
+        QCoreApplication::processEvents();
+        const double seconds = wall.nsecsElapsed() / 1e9;
+
+        formatCleanupCallback(this);
+        report(name, width, height, bitDepth, seconds);
+    }
+
+    /** @brief Plays a local clip through libVLC for up to `seconds` and reports */
+    void runClip(const QString& path, int seconds) {
+        reset();
+        libvlc_media_player_t* player = m_handler.m_mediaPlayer;
+        const QString location = path.startsWith("file://") ? path : QUrl::fromLocalFile(path).toString(QUrl::FullyEncoded);
+        libvlc_media_t* media = libvlc_media_new_location(m_handler.m_vlcInstance, location.toUtf8().constData());
+        if (!media) {
+            fprintf(stderr, "[GHOST] bench: cannot open %s\n", location.toUtf8().constData());
+            return;
+        }
+        libvlc_media_add_option(media, ":avcodec-hw=none");
+        libvlc_media_add_option(media, ":no-audio");
+        libvlc_media_player_set_media(player, media);
+        libvlc_media_release(media);
+
+        libvlc_video_set_format_callbacks(player, &formatCallback, &formatCleanupCallback);
+        libvlc_video_set_callbacks(player, &lockCallback, &unlockCallback, &displayCallback, this);
+
+        QElapsedTimer wall;
+        wall.start();
+        libvlc_media_player_play(player);
+        QEventLoop loop;
+        QTimer poll;
+        QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+            const libvlc_state_t state = libvlc_media_player_get_state(player);
+            if (state == libvlc_Ended || state == libvlc_Error || wall.elapsed() >= seconds * 1000LL)
+                loop.quit();
+        });
+        poll.start(100);
+        loop.exec();
+        const double elapsed = wall.nsecsElapsed() / 1e9;
+        libvlc_media_player_stop(player);
+        QCoreApplication::processEvents();
+
+        report(QFileInfo(path).fileName().toUtf8().constData(), m_clipWidth, m_clipHeight, m_clipBitDepth, elapsed);
+    }
+
+private:
+    static FramePipelineBenchmark* self(void* opaque) { return static_cast<FramePipelineBenchmark*>(opaque); }
+
+    static unsigned formatCallback(void** opaque, char* chroma, unsigned* width, unsigned* height,
+                                   unsigned* pitches, unsigned* lines) {
+        FramePipelineBenchmark* bench = self(*opaque);
+        void* handler = &bench->m_handler;
+        const unsigned result = VLCPlayerHandler::videoFormatCallback(&handler, chroma, width, height, pitches, lines);
+        bench->m_clipWidth = static_cast<int>(*width);
+        bench->m_clipHeight = static_cast<int>(*height);
+        bench->m_clipBitDepth = bench->m_handler.m_bitDepth;
+        return result;
+    }
+
+    static void formatCleanupCallback(void* opaque) {
+        VLCPlayerHandler::videoFormatCleanupCallback(&self(opaque)->m_handler);
+    }
+
+    static void* lockCallback(void* opaque, void** planes) {
+        FramePipelineBenchmark* bench = self(opaque);
+        QElapsedTimer timer;
+        timer.start();
+        void* picture = VLCPlayerHandler::videoLockCallback(&bench->m_handler, planes);
+        bench->m_lockTimes.push_back(timer.nsecsElapsed() / 1e6);
+        return picture;
+    }
+
+    static void unlockCallback(void* opaque, void* picture, void* const* planes) {
+        VLCPlayerHandler::videoUnlockCallback(&self(opaque)->m_handler, picture, planes);
+    }
+
+    static void displayCallback(void* opaque, void* picture) {
+        VLCPlayerHandler::videoDisplayCallback(&self(opaque)->m_handler, picture);
+    }
+
+    void deliver() {
+        const quint64 before = m_sinkFrames;
+        QElapsedTimer timer;
+        timer.start();
+        m_handler.deliverFrame();
+        const double ms = timer.nsecsElapsed() / 1e6;
+        if (m_sinkFrames != before) m_deliverTimes.push_back(ms);
+    }
+
+    static void fillPlane(std::vector<uint8_t>& plane, unsigned pitch, unsigned lines, int bitDepth, int base) {
+        // Diagonal ramps, so the converter sees varying samples on every row.
+        for (unsigned row = 0; row < lines; ++row) {
+            uint8_t* line = plane.data() + static_cast<size_t>(row) * pitch;
+            if (bitDepth > 8) {
+                auto* samples = reinterpret_cast<uint16_t*>(line);
+                for (unsigned x = 0; x < pitch / 2; ++x)
+                    samples[x] = static_cast<uint16_t>((base * 4 + x + row) % 1024);
+            } else {
+                for (unsigned x = 0; x < pitch; ++x)
+                    line[x] = static_cast<uint8_t>(base + x + row);
+            }
+        }
+    }
+
+    static double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        const size_t index = std::min(values.size() - 1, static_cast<size_t>(p * (values.size() - 1) + 0.5));
+        return values[index];
+    }
+
+    void reset() {
+        m_sinkFrames = 0;
+        m_lockTimes.clear();
+        m_deliverTimes.clear();
+        m_clipWidth = m_clipHeight = 0;
+        m_clipBitDepth = 8;
+    }
+
+    void report(const char* name, int width, int height, int bitDepth, double seconds) const {
+        printf("%-12s %4dx%-4d %2d-bit  %6llu frames  %7.1f fps | deliver p50 %6.2f p95 %6.2f p99 %6.2f max %6.2f ms"
+               " | lock p50 %6.3f p99 %6.3f max %6.3f ms\n",
+               name, width, height, bitDepth, static_cast<unsigned long long>(m_sinkFrames),
+               seconds > 0 ? m_sinkFrames / seconds : 0.0,
+               percentile(m_deliverTimes, 0.50), percentile(m_deliverTimes, 0.95),
+               percentile(m_deliverTimes, 0.99), percentile(m_deliverTimes, 1.0),
+               percentile(m_lockTimes, 0.50), percentile(m_lockTimes, 0.99), percentile(m_lockTimes, 1.0));
+        fflush(stdout);
+    }
+
+    VLCPlayerHandler& m_handler;
+    quint64 m_sinkFrames = 0;
+    std::vector<double> m_lockTimes;     // ms spent in videoLockCallback
+    std::vector<double> m_deliverTimes;  // ms per deliverFrame that reached the sink
+    int m_clipWidth = 0;
+    int m_clipHeight = 0;
+    int m_clipBitDepth = 8;
+};
+
+/**
+ * @brief Times convertI420ToBgra per kernel, matrix and range at 4K
+ *
+ * Single-threaded, straight on the converter: the slicer and the sink
+ * would only add the same cost to every variant.
+ */
+static void runConverterVariants(int bitDepth, int frames) {
+    using namespace YuvConverter;
+    const int width = 3840;
+    const int height = 2160;
+    const int bytes = bitDepth > 8 ? 2 : 1;
+    // Same padding as videoFormatCallback negotiates.
+    const int pitches[3] = { ((width + 63) & ~63) * bytes, ((width + 63) & ~63) / 2 * bytes,
+                             ((width + 63) & ~63) / 2 * bytes };
+    const int lines[3] = { height, height / 2, height / 2 };
+    std::vector<uint8_t> source[3];
+    for (int i = 0; i < 3; ++i) {
+        source[i].resize(static_cast<size_t>(pitches[i]) * lines[i]);
+        for (size_t x = 0; x < source[i].size(); ++x)
+            source[i][x] = static_cast<uint8_t>(x * 7 + i * 64);
+        if (bitDepth > 8) {
+            auto* samples = reinterpret_cast<uint16_t*>(source[i].data());
+            for (size_t x = 0; x < source[i].size() / 2; ++x) samples[x] &= 0x3ff;
+        }
+    }
+    I420Planes src;
+    src.y = source[0].data();
+    src.u = source[1].data();
+    src.v = source[2].data();
+    src.pitchY = pitches[0];
+    src.pitchU = pitches[1];
+    src.pitchV = pitches[2];
+    src.width = width;
+    src.height = height;
+    src.bitDepth = bitDepth;
+    const int dstPitch = width * 4;
+    std::vector<uint8_t> dst(static_cast<size_t>(dstPitch) * height);
+
+    const Kernel kernels[] = { Kernel::Scalar, Kernel::Sse2, Kernel::Avx2, Kernel::Neon };
+    const ColorMatrix matrices[] = { ColorMatrix::Bt601, ColorMatrix::Bt709, ColorMatrix::Bt2020 };
+    const ColorRange ranges[] = { ColorRange::Limited, ColorRange::Full };
+    printf("converter variants, %dx%d %d-bit, %d frames each (vs BT.601 limited on the same kernel)\n",
+           width, height, bitDepth, frames);
+    for (Kernel kernel : kernels) {
+        if (!isSupported(kernel))
+            continue;
+        double baseline = 0.0;
+        for (ColorMatrix matrix : matrices) {
+            for (ColorRange range : ranges) {
+                src.matrix = matrix;
+                src.range = range;
+                convertI420ToBgra(src, dst.data(), dstPitch, kernel);  // warm-up
+                std::vector<double> times;
+                for (int n = 0; n < frames; ++n) {
+                    QElapsedTimer timer;
+                    timer.start();
+                    convertI420ToBgra(src, dst.data(), dstPitch, kernel);
+                    times.push_back(timer.nsecsElapsed() / 1e6);
+                }
+                std::sort(times.begin(), times.end());
+                const double median = times[times.size() / 2];
+                if (baseline <= 0.0)
+                    baseline = median;
+                printf("  %-6s %-7s %-7s  p50 %7.2f ms  min %7.2f ms  %5.2fx baseline\n", kernelName(kernel),
+                       colorMatrixName(matrix), range == ColorRange::Full ? "full" : "limited",
+                       median, times.front(), median / baseline);
+                fflush(stdout);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Runs without a display unless a platform is forced.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    // Anything that still reaches for AppData or the cache lands in the
+    // test locations, never in the user's.
+    QStandardPaths::setTestModeEnabled(true);
+
+    int frames = 300;
+    int bitDepth = 8;
+    int seconds = 20;
+    QSize output;
+    QString clip;
+    bool variants = false;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString& arg = args[i];
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--frames" && hasValue) {
+            frames = std::max(1, args[++i].toInt());
+        } else if (arg == "--10bit") {
+            bitDepth = 10;
+        } else if (arg == "--output" && hasValue) {
+            const QStringList size = args[++i].split('x');
+            if (size.size() == 2) output = QSize(size[0].toInt(), size[1].toInt());
+        } else if (arg == "--clip" && hasValue) {
+            clip = args[++i];
+        } else if (arg == "--seconds" && hasValue) {
+            seconds = std::max(1, args[++i].toInt());
+        } else if (arg == "--variants") {
+            variants = true;
+        } else {
+            fprintf(stderr, "usage: %s [--frames N] [--10bit] [--output WxH] [--clip PATH] [--seconds S]"
+                            " [--variants]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // No conf.ini, stream proxy, progress journal or server updates.
+    VLCPlayerHandler handler(VLCPlayerHandler::Mode::Headless);
+    if (!handler.m_mediaPlayer) {
+        fprintf(stderr, "[GHOST] bench: libVLC failed to initialise\n");
+        return 1;
+    }
+    QVideoSink sink;
+    handler.setVideoSink(&sink);
+    handler.m_outputSize = output;
+
+    FramePipelineBenchmark bench(handler, sink);
+    bench.runSynthetic("720p", 1280, 720, bitDepth, frames);
+    bench.runSynthetic("1080p", 1920, 1080, bitDepth, frames);
+    bench.runSynthetic("4K", 3840, 2160, bitDepth, frames);
+    if (!clip.isEmpty())
+        bench.runClip(clip, seconds);
+    if (variants)
+        runConverterVariants(bitDepth, frames);
+    return 0;
+}
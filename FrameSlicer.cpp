@@ -0,0 +1,60 @@
+#include "FrameSlicer.h"
+#include <QSemaphore>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+// Below about a megapixel per slice the wake-up cost of a worker outweighs
+// what it saves.
+constexpr qint64 kPixelsPerSlice = 1 << 20;
+}
+
+FrameSlicer::FrameSlicer() {
+    // The calling thread takes one slice, so the pool needs one thread less
+    // than there are cores.
+    m_pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+    m_pool.setThreadPriority(QThread::HighPriority);
+    // Keep workers parked between frames instead of respawning them.
+    m_pool.setExpiryTimeout(-1);
+}
+
+FrameSlicer::~FrameSlicer() {
+    m_pool.waitForDone();
+}
+
+int FrameSlicer::sliceCount(int width, int height) const {
+    const qint64 pixels = static_cast<qint64>(width) * height;
+    const int wanted = static_cast<int>((pixels + kPixelsPerSlice - 1) / kPixelsPerSlice);
+    const int cores = m_pool.maxThreadCount() + 1;
+    // Every slice needs at least one chroma row pair.
+    return std::clamp(std::min(wanted, cores), 1, std::max(1, height / 2));
+}
+
+void FrameSlicer::run(int width, int height, const std::function<void(int, int)>& work) {
+    if (height <= 0) return;
+
+    const int slices = sliceCount(width, height);
+    if (slices == 1) {
+        work(0, height);
+        return;
+    }
+
+    // Round the slice height up to an even number of rows.
+    const int rowsPerSlice = ((height + slices - 1) / slices + 1) & ~1;
+
+    QSemaphore done;
+    int queued = 0;
+    int row = rowsPerSlice;  // slice 0 runs on this thread
+    for (; row < height; row += rowsPerSlice) {
+        const int rowBegin = row;
+        const int rowEnd = std::min(height, row + rowsPerSlice);
+        m_pool.start([&work, &done, rowBegin, rowEnd]() {
+            work(rowBegin, rowEnd);
+            done.release();
+        });
+        ++queued;
+    }
+
+    work(0, std::min(height, rowsPerSlice));
+    done.acquire(queued);
+}
@@ -0,0 +1,45 @@
+#ifndef FRAMESLICER_H
+#define FRAMESLICER_H
+
+#include <QThreadPool>
+#include <functional>
+
+/**
+ * @brief Splits per-row frame work into horizontal slices run in parallel
+ *
+ * Owns a small dedicated thread pool so frame conversion never competes
+ * with QThreadPool::globalInstance() users. The calling thread converts one
+ * slice itself and run() only returns once every slice has finished.
+ *
+ * Slice boundaries always fall on even rows, so a 4:2:0 chroma row pair is
+ * never split between two workers.
+ */
+class FrameSlicer {
+public:
+    FrameSlicer();
+    ~FrameSlicer();
+
+    FrameSlicer(const FrameSlicer&) = delete;
+    FrameSlicer& operator=(const FrameSlicer&) = delete;
+
+    /**
+     * @brief Number of slices used for a frame of the given size
+     *
+     * Roughly one slice per megapixel, capped at the number of cores, so
+     * 720p stays on one thread and 4K spreads across all of them.
+     */
+    int sliceCount(int width, int height) const;
+
+    /**
+     * @brief Runs work(rowBegin, rowEnd) over [0, height) and joins
+     * @param width Frame width, used to size the slices
+     * @param height Number of rows to cover
+     * @param work Called once per slice, possibly concurrently
+     */
+    void run(int width, int height, const std::function<void(int, int)>& work);
+
+private:
+    QThreadPool m_pool;
+};
+
+#endif // FRAMESLICER_H
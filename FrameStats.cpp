@@ -0,0 +1,59 @@
+#include "FrameStats.h"
+#include <algorithm>
+
+namespace {
+// Nearest-rank percentile of an already sorted list.
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+}
+
+void FrameStats::recordLock(qint64 nanos) {
+    const quint64 value = static_cast<quint64>(std::max<qint64>(0, nanos));
+    m_lockNanos.fetch_add(value, std::memory_order_relaxed);
+    m_lockCount.fetch_add(1, std::memory_order_relaxed);
+    // Only the video thread writes the maximum; sample() resets it.
+    if (value > m_lockMaxNanos.load(std::memory_order_relaxed))
+        m_lockMaxNanos.store(value, std::memory_order_relaxed);
+}
+
+void FrameStats::recordDelivery(qint64 latencyNanos, qint64 conversionNanos) {
+    ++m_delivered;
+    m_latency.push_back(latencyNanos / 1e6);
+    m_conversion.push_back(conversionNanos / 1e6);
+}
+
+QVariantMap FrameStats::sample(quint64 decoded, quint64 dropped, double seconds) {
+    const quint64 lockNanos = m_lockNanos.exchange(0, std::memory_order_relaxed);
+    const quint64 lockCount = m_lockCount.exchange(0, std::memory_order_relaxed);
+    const quint64 lockMax = m_lockMaxNanos.exchange(0, std::memory_order_relaxed);
+
+    std::sort(m_conversion.begin(), m_conversion.end());
+    double latencySum = 0.0;
+    double latencyMax = 0.0;
+    for (double latency : m_latency) {
+        latencySum += latency;
+        latencyMax = std::max(latencyMax, latency);
+    }
+
+    QVariantMap stats;
+    stats["decodedFrames"] = static_cast<qulonglong>(decoded);
+    stats["deliveredFrames"] = static_cast<qulonglong>(m_delivered);
+    stats["droppedFrames"] = static_cast<qulonglong>(dropped);
+    stats["deliveredFps"] = seconds > 0.0 ? m_conversion.size() / seconds : 0.0;
+    stats["latencyMeanMs"] = m_latency.empty() ? 0.0 : latencySum / m_latency.size();
+    stats["latencyMaxMs"] = latencyMax;
+    stats["conversionP50Ms"] = percentile(m_conversion, 0.50);
+    stats["conversionP95Ms"] = percentile(m_conversion, 0.95);
+    stats["conversionP99Ms"] = percentile(m_conversion, 0.99);
+    stats["conversionMaxMs"] = m_conversion.empty() ? 0.0 : m_conversion.back();
+    stats["lockMeanMs"] = lockCount ? lockNanos / 1e6 / lockCount : 0.0;
+    stats["lockMaxMs"] = lockMax / 1e6;
+
+    // clear() keeps the capacity, so steady playback stops allocating.
+    m_latency.clear();
+    m_conversion.clear();
+    return stats;
+}
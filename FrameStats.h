@@ -0,0 +1,51 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <QVariantMap>
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief Rolling health counters for the video frame path
+ *
+ * Cheap enough to leave on: VLC's video thread only bumps relaxed atomics,
+ * the GUI thread appends to plain vectors, and sample() turns the last
+ * interval into percentiles once a second. Totals cover the handler's
+ * lifetime, like TripleBuffer's counters.
+ */
+class FrameStats {
+public:
+    /** @brief Time spent getting a picture in videoLockCallback (video thread) */
+    void recordLock(qint64 nanos);
+
+    /**
+     * @brief One frame handed to the sink (GUI thread)
+     * @param latencyNanos From VLC's display call to setVideoFrame
+     * @param conversionNanos Spent in deliverFrame converting or wrapping it
+     */
+    void recordDelivery(qint64 latencyNanos, qint64 conversionNanos);
+
+    /**
+     * @brief Summarises the interval since the previous sample (GUI thread)
+     * @param decoded Frames VLC has published in total
+     * @param dropped Frames overwritten before delivery in total
+     * @param seconds Length of the interval, for the delivery rate
+     *
+     * Keys: decodedFrames, deliveredFrames, droppedFrames, deliveredFps,
+     * latencyMeanMs, latencyMaxMs, conversionP50Ms, conversionP95Ms,
+     * conversionP99Ms, conversionMaxMs, lockMeanMs, lockMaxMs.
+     */
+    QVariantMap sample(quint64 decoded, quint64 dropped, double seconds);
+
+private:
+    std::atomic<quint64> m_lockNanos{ 0 };
+    std::atomic<quint64> m_lockCount{ 0 };
+    std::atomic<quint64> m_lockMaxNanos{ 0 };
+
+    quint64 m_delivered = 0;
+    std::vector<double> m_latency;     // ms, current interval
+    std::vector<double> m_conversion;  // ms, current interval
+};
+
+#endif // FRAMESTATS_H
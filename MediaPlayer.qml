@@ -13,6 +13,8 @@ Rectangle {
     required property string title
     required property var mediaMetadata
     required property string episodeType
+    // Episode after this one, pre-rolled near the end; empty for none
+    property string nextMediaId: ""
 
     property bool isLoading: true
 
@@ -83,6 +85,16 @@ Rectangle {
                 }
             }
 
+            Text {
+                anchors.horizontalCenter: parent.horizontalCenter
+                anchors.top: loadingImage.bottom
+                anchors.topMargin: 24
+                visible: mediaPlayer.bufferingProgress > 0 && mediaPlayer.bufferingProgress < 100
+                text: qsTr("Buffering %1%").arg(Math.round(mediaPlayer.bufferingProgress))
+                color: "#B3FFFFFF"
+                font.pixelSize: 18
+            }
+
             RotationAnimation {
                 target: rotation
                 property: "angle"
@@ -107,12 +119,24 @@ Rectangle {
     VideoOutput {
         id: videoOutput
         anchors.fill: parent
-        visible: true
+        visible: !mediaPlayer.audioOnly
         fillMode: VideoOutput.PreserveAspectFit
     }
 
+    // Stands in for the picture while only audio is decoded
+    Text {
+        anchors.centerIn: parent
+        visible: mediaPlayer.audioOnly
+        text: root.title
+        color: "white"
+        font.pixelSize: 28
+        font.bold: true
+    }
+
     VLCPlayerHandler {
         id: mediaPlayer
+        videoOutput: videoOutput
+        nextMediaId: root.nextMediaId
 
         Component.onCompleted: {
             if (root.mediaId) {
@@ -265,6 +289,33 @@ Rectangle {
                         Behavior on width { NumberAnimation { duration: 120 } }
                     }
 
+                    // Seek preview from the background thumbnail extractor
+                    Rectangle {
+                        id: seekPreview
+                        readonly property real previewPosition: progressMouseArea.pressed
+                            ? progressMouseArea.dragPosition
+                            : (progressMouseArea.mouseX / progressMouseArea.width) * mediaPlayer.duration
+                        visible: (progressMouseArea.containsMouse || progressMouseArea.pressed)
+                                 && mediaPlayer.thumbnailCount > 0
+                        width: 192 + 4
+                        height: previewImage.implicitHeight + 4
+                        x: mediaPlayer.duration > 0 ?
+                           Math.max(0, Math.min(parent.width - width,
+                                    (previewPosition / mediaPlayer.duration) * parent.width - width / 2)) : 0
+                        y: -height - 12
+                        color: "black"
+                        border.color: "#66FFFFFF"
+                        radius: 4
+
+                        Image {
+                            id: previewImage
+                            anchors.centerIn: parent
+                            asynchronous: true
+                            // thumbnailCount re-evaluates the URL as thumbnails arrive
+                            source: mediaPlayer.thumbnailCount > 0 ? mediaPlayer.thumbnailAt(seekPreview.previewPosition) : ""
+                        }
+                    }
+
                     MouseArea {
                         id: progressMouseArea
                         anchors.fill: parent
@@ -280,10 +331,13 @@ Rectangle {
                         onPositionChanged: (mouse) => {
                             if (pressed) {
                                 dragPosition = (mouse.x / width) * mediaPlayer.duration
+                                // Keyframe previews while dragging; exact seek on release
+                                mediaPlayer.scrubTo(Math.max(0, Math.min(dragPosition, mediaPlayer.duration)))
                             }
                         }
                         onReleased: (mouse) => {
                             mediaPlayer.setPosition(Math.max(0, Math.min(dragPosition, mediaPlayer.duration)))
+                            dragPosition = Qt.binding(() => mediaPlayer.position)
                         }
                     }
                 }
@@ -603,6 +657,15 @@ Rectangle {
                     }
                 }
             }
+
+            // Listening in the background: no video is decoded
+            Switch {
+                id: audioOnlySwitch
+                Layout.fillWidth: true
+                text: "<font color=\"white\">Audio only</font>"
+                checked: mediaPlayer.audioOnly
+                onToggled: mediaPlayer.setAudioOnly(checked)
+            }
         }
     }
 }
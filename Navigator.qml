@@ -987,6 +987,7 @@ Item {
                     title: navigator.getMediaTitle(currentMediaId)
                     mediaMetadata: navigator.getMediaMetadata(currentMediaId)
                     episodeType: navigator.getEpisodeType(currentMediaId)
+                    nextMediaId: navigator.getNextEpisode(mediaId, 1)
                     
                     onCloseRequested: {
                         isPlayerVisible = false
@@ -0,0 +1,85 @@
+#include "NetworkCachingPolicy.h"
+#include <QDir>
+#include <QSettings>
+#include <QStandardPaths>
+#include <algorithm>
+
+namespace {
+// Used until a first session has been measured: the old fixed value.
+constexpr int kDefaultCachingMs = 5000;
+constexpr int kMinCachingMs = 300;
+constexpr int kMaxCachingMs = 15000;
+// Weight of a new sample in the running estimates.
+constexpr double kSmoothing = 0.3;
+
+double smooth(double current, double sample) {
+    return current > 0.0 ? current + kSmoothing * (sample - current) : sample;
+}
+}
+
+void NetworkCachingPolicy::load(const QString& configPath) {
+    // conf.ini belongs to the user (and to git in development builds), and
+    // may not be writable next to an installed binary: never written here.
+    m_fixedCachingMs = QSettings(configPath, QSettings::IniFormat).value("networkCachingMs", 0).toInt();
+
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    m_statePath = dir + "/network.ini";
+    QSettings settings(m_statePath, QSettings::IniFormat);
+    m_connectMs = settings.value("networkConnectMs", 0.0).toDouble();
+    m_throughputKbps = settings.value("networkThroughputKbps", 0.0).toDouble();
+    m_bitrateKbps = settings.value("streamBitrateKbps", 0.0).toDouble();
+    m_boost = std::clamp(settings.value("networkCachingBoost", 1.0).toDouble(), 1.0, 4.0);
+}
+
+void NetworkCachingPolicy::save() const {
+    if (m_statePath.isEmpty()) return;
+    QSettings settings(m_statePath, QSettings::IniFormat);
+    settings.setValue("networkConnectMs", qRound(m_connectMs));
+    settings.setValue("networkThroughputKbps", qRound(m_throughputKbps));
+    settings.setValue("streamBitrateKbps", qRound(m_bitrateKbps));
+    settings.setValue("networkCachingBoost", m_boost);
+}
+
+int NetworkCachingPolicy::cachingMs() const {
+    if (m_fixedCachingMs > 0)
+        return m_fixedCachingMs;
+    if (m_connectMs <= 0.0)
+        return kDefaultCachingMs;
+
+    // Enough to ride out a few round trips of jitter on a healthy link...
+    double ms = kMinCachingMs + 6.0 * m_connectMs;
+    if (m_throughputKbps > 0.0 && m_bitrateKbps > 0.0) {
+        // ...plus a cushion that grows as the link gets close to the
+        // stream's bitrate and a hiccup can no longer be caught up quickly.
+        const double headroom = std::max(0.5, m_throughputKbps / m_bitrateKbps);
+        if (headroom < 3.0)
+            ms += 2000.0 * (3.0 - headroom);
+    }
+    ms *= m_boost;
+    return std::clamp(static_cast<int>(ms), kMinCachingMs, kMaxCachingMs);
+}
+
+void NetworkCachingPolicy::recordConnect(qint64 ms) {
+    m_connectMs = smooth(m_connectMs, static_cast<double>(std::max<qint64>(1, ms)));
+}
+
+void NetworkCachingPolicy::recordThroughput(double kbps) {
+    if (kbps > 0.0) m_throughputKbps = smooth(m_throughputKbps, kbps);
+}
+
+void NetworkCachingPolicy::recordBitrate(double kbps) {
+    if (kbps > 0.0) m_bitrateKbps = smooth(m_bitrateKbps, kbps);
+}
+
+void NetworkCachingPolicy::recordRebuffer() {
+    ++m_sessionRebuffers;
+    m_boost = std::min(4.0, m_boost * 1.5);
+}
+
+void NetworkCachingPolicy::finishSession() {
+    if (m_sessionRebuffers == 0)
+        m_boost = std::max(1.0, m_boost * 0.85);
+    m_sessionRebuffers = 0;
+    save();
+}
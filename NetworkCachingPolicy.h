@@ -0,0 +1,63 @@
+#ifndef NETWORKCACHINGPOLICY_H
+#define NETWORKCACHINGPOLICY_H
+
+#include <QString>
+
+/**
+ * @brief Chooses libVLC's :network-caching from measured network conditions
+ *
+ * The handler feeds it what each stream open and playback reveal: how long
+ * the server took to deliver the first data, how fast VLC could read while
+ * filling its buffer, the content's bitrate and every mid-playback stall.
+ * Estimates are smoothed across sessions and kept in
+ * AppDataLocation/network.ini, so a LAN client converges on a few hundred
+ * milliseconds of cache (fast start) while a slow or flaky link gets more
+ * (fewer rebuffers). conf.ini is only read, for networkCachingMs: a fixed
+ * value that replaces the estimate when set.
+ *
+ * libVLC 3 can't change the cache of a running input, so a value always
+ * applies to the next media opened (next episode, pre-roll, reload).
+ */
+class NetworkCachingPolicy {
+public:
+    /**
+     * @brief Reads the user's override from configPath and earlier estimates
+     *        from AppDataLocation
+     */
+    void load(const QString& configPath);
+
+    /** @brief Writes the current estimates to AppDataLocation; no-op before load() */
+    void save() const;
+
+    /** @brief :network-caching value in milliseconds for the next media */
+    int cachingMs() const;
+
+    /** @brief Smoothed link throughput in kb/s, 0 while unknown */
+    double throughputKbps() const { return m_throughputKbps; }
+
+    /** @brief Time from play to the first buffered data, a round-trip proxy */
+    void recordConnect(qint64 ms);
+
+    /** @brief Read rate measured while VLC was filling its buffer */
+    void recordThroughput(double kbps);
+
+    /** @brief Content bitrate the demuxer reported during playback */
+    void recordBitrate(double kbps);
+
+    /** @brief Playback stalled to rebuffer after it had started */
+    void recordRebuffer();
+
+    /** @brief A media finished or was replaced; relaxes after clean sessions */
+    void finishSession();
+
+private:
+    QString m_statePath;            // AppDataLocation/network.ini, set by load()
+    int m_fixedCachingMs = 0;       // conf.ini networkCachingMs, 0 = learn
+    double m_connectMs = 0.0;       // 0 = unknown
+    double m_throughputKbps = 0.0;  // 0 = unknown
+    double m_bitrateKbps = 0.0;     // 0 = unknown
+    double m_boost = 1.0;           // grows with rebuffers, decays without
+    int m_sessionRebuffers = 0;
+};
+
+#endif // NETWORKCACHINGPOLICY_H
@@ -0,0 +1,229 @@
+#include "ProgressJournal.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QNetworkAccessManager>
+#include <QNetworkInformation>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+// After an event that matters: long enough to merge a burst of them.
+constexpr int kUrgentFlushMs = 2000;
+// Periodic progress only needs to reach the server now and then.
+constexpr int kPeriodicFlushMs = 2 * 60 * 1000;
+constexpr int kMinBackoffMs = 5000;
+constexpr int kMaxBackoffMs = 5 * 60 * 1000;
+// Compact once the file holds this many lines.
+constexpr int kCompactLines = 500;
+}
+
+ProgressJournal::ProgressJournal(QObject* parent)
+    : QObject(parent)
+{
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    connect(m_flushTimer, &QTimer::timeout, this, &ProgressJournal::flush);
+
+    // Retry as soon as the link is back instead of waiting out the backoff.
+    if (QNetworkInformation::loadDefaultBackend()) {
+        connect(QNetworkInformation::instance(), &QNetworkInformation::reachabilityChanged, this,
+                [this](QNetworkInformation::Reachability reachability) {
+                    if (reachability == QNetworkInformation::Reachability::Online && !m_pending.isEmpty()) {
+                        m_failures = 0;
+                        scheduleFlush(0);
+                    }
+                });
+    }
+}
+
+void ProgressJournal::setServer(const QString& serverUrl, const QString& token, QNetworkAccessManager* network) {
+    m_url = serverUrl;
+    m_token = token;
+    m_network = network;
+    if (m_path.isEmpty()) {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dir);
+        m_path = dir + "/progress.journal";
+        load();
+    }
+    // Whatever an earlier session could not deliver.
+    if (!m_pending.isEmpty())
+        scheduleFlush(kUrgentFlushMs);
+}
+
+void ProgressJournal::record(const QJsonObject& payload, const QString& event, bool urgent) {
+    const QString key = keyOf(payload);
+    if (key.isEmpty())
+        return;
+
+    Entry entry;
+    entry.seq = ++m_seq;
+    entry.payload = payload;
+    m_pending.insert(key, entry);
+
+    QJsonObject line;
+    line["seq"] = entry.seq;
+    line["event"] = event;
+    line["time"] = QDateTime::currentMSecsSinceEpoch();
+    line["payload"] = payload;
+    append(line);
+
+    // While backing off the retry timer stays in charge.
+    if (m_failures == 0)
+        scheduleFlush(urgent ? kUrgentFlushMs : kPeriodicFlushMs);
+}
+
+void ProgressJournal::flush() {
+    if (m_inFlight > 0 || m_pending.isEmpty() || m_url.isEmpty() || !m_network)
+        return;
+    m_flushTimer->stop();
+    m_flushFailed = false;
+
+    // The server takes one update per request; a flush sends the newest
+    // state of each media together, however many events led to it.
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+        QNetworkRequest request(QUrl(m_url + "/update_media_metadata"));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+        request.setRawHeader("Authorization", "Bearer " + m_token.toUtf8());
+        QNetworkReply* reply = m_network->post(request, QJsonDocument(it->payload).toJson(QJsonDocument::Compact));
+        ++m_inFlight;
+
+        const QString key = it.key();
+        const qint64 seq = it->seq;
+        connect(reply, &QNetworkReply::finished, this, [this, reply, key, seq]() {
+            reply->deleteLater();
+            --m_inFlight;
+            const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (reply->error() == QNetworkReply::NoError && status >= 200 && status < 300) {
+                acknowledge(key, seq);
+            } else {
+                qDebug() << "Error updating media metadata:" << reply->errorString();
+                m_flushFailed = true;
+            }
+            if (m_inFlight == 0)
+                onFlushFinished();
+        });
+    }
+}
+
+void ProgressJournal::onFlushFinished() {
+    if (m_flushFailed) {
+        const int delay = std::min(kMaxBackoffMs, kMinBackoffMs << std::min(m_failures, 10));
+        ++m_failures;
+        fprintf(stderr, "[GHOST] progress sync failed, %d update(s) kept; retrying in %d s\n",
+                static_cast<int>(m_pending.size()), delay / 1000);
+        fflush(stderr);
+        m_flushTimer->start(delay);
+        return;
+    }
+    m_failures = 0;
+    if (m_lines >= kCompactLines)
+        compact();
+    // Updates recorded while the flush was in flight.
+    if (!m_pending.isEmpty())
+        scheduleFlush(kUrgentFlushMs);
+}
+
+void ProgressJournal::acknowledge(const QString& key, qint64 seq) {
+    QJsonObject line;
+    line["ack"] = seq;
+    append(line);
+    // A newer update for the same media stays pending.
+    auto it = m_pending.find(key);
+    if (it != m_pending.end() && it->seq == seq)
+        m_pending.erase(it);
+}
+
+void ProgressJournal::scheduleFlush(int delayMs) {
+    // Never postpone a flush that is already due sooner.
+    if (m_flushTimer->isActive() && m_flushTimer->remainingTime() <= delayMs)
+        return;
+    m_flushTimer->start(delayMs);
+}
+
+QString ProgressJournal::keyOf(const QJsonObject& payload) {
+    const QString mediaId = payload.value("mediaID").toString();
+    if (mediaId.isEmpty())
+        return QString();
+    return payload.value("profileID").toString() + "/" + mediaId;
+}
+
+void ProgressJournal::load() {
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    QHash<qint64, QString> keyBySeq;
+    while (!file.atEnd()) {
+        const QByteArray text = file.readLine().trimmed();
+        if (text.isEmpty())
+            continue;
+        ++m_lines;
+        // A line cut short by a crash is simply skipped.
+        const QJsonObject line = QJsonDocument::fromJson(text).object();
+        if (line.contains("ack")) {
+            const qint64 seq = line.value("ack").toInteger();
+            const QString key = keyBySeq.value(seq);
+            auto it = m_pending.find(key);
+            if (it != m_pending.end() && it->seq == seq)
+                m_pending.erase(it);
+        } else if (line.contains("seq")) {
+            Entry entry;
+            entry.seq = line.value("seq").toInteger();
+            entry.payload = line.value("payload").toObject();
+            const QString key = keyOf(entry.payload);
+            if (key.isEmpty())
+                continue;
+            keyBySeq.insert(entry.seq, key);
+            auto it = m_pending.find(key);
+            if (it == m_pending.end() || it->seq < entry.seq)
+                m_pending.insert(key, entry);
+        }
+        m_seq = std::max(m_seq, line.value("seq").toInteger());
+    }
+    file.close();
+
+    if (!m_pending.isEmpty()) {
+        fprintf(stderr, "[GHOST] progress journal: %d update(s) from an earlier session to sync\n",
+                static_cast<int>(m_pending.size()));
+        fflush(stderr);
+    }
+    compact();
+}
+
+void ProgressJournal::append(const QJsonObject& line) {
+    if (m_path.isEmpty())
+        return;
+    QFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        fprintf(stderr, "[GHOST] progress journal: cannot write %s\n", m_path.toUtf8().constData());
+        fflush(stderr);
+        return;
+    }
+    file.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n');
+    ++m_lines;
+}
+
+void ProgressJournal::compact() {
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    m_lines = 0;
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+        QJsonObject line;
+        line["seq"] = it->seq;
+        line["event"] = "pending";
+        line["payload"] = it->payload;
+        file.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n');
+        ++m_lines;
+    }
+    file.commit();
+}
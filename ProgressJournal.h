@@ -0,0 +1,87 @@
+#ifndef PROGRESSJOURNAL_H
+#define PROGRESSJOURNAL_H
+
+#include <QObject>
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QTimer>
+
+class QNetworkAccessManager;
+
+/**
+ * @brief Durable outbox for watch-progress updates to the server
+ *
+ * Every update is appended to a local journal (one JSON line per event,
+ * AppDataLocation/progress.journal) before anything goes on the network,
+ * so a resume position survives a crash, a closed app or a dead link.
+ * Only the newest update per profile and media is kept pending. Pending
+ * updates go out together: shortly after an event that matters (pause,
+ * seek, stop, track change, end), every couple of minutes for periodic
+ * ones, and straight away when the network comes back. Failed flushes
+ * retry with exponential backoff. Acknowledged updates are journaled as
+ * such, and the file is compacted to what is still pending now and then.
+ */
+class ProgressJournal : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ProgressJournal(QObject* parent = nullptr);
+
+    /**
+     * @brief Where and how updates are sent; pending ones go out soon after
+     *
+     * The first call opens the journal. Until then nothing is read from or
+     * written to disk, and updates are only kept in memory.
+     * @param serverUrl Base URL of the server
+     * @param token Bearer token for the Authorization header
+     * @param network Manager the requests are made on (not owned)
+     */
+    void setServer(const QString& serverUrl, const QString& token, QNetworkAccessManager* network);
+
+    /**
+     * @brief Journals an update_media_metadata payload
+     * @param payload Body of the request; profileID and mediaID form the key
+     * @param event What caused it, e.g. "pause" or "periodic"
+     * @param urgent Flush within seconds instead of at the next periodic flush
+     */
+    void record(const QJsonObject& payload, const QString& event, bool urgent);
+
+    /** @brief Number of updates not yet acknowledged by the server */
+    int pendingCount() const { return m_pending.size(); }
+
+public slots:
+    /** @brief Sends every pending update now unless a flush is in flight */
+    void flush();
+
+private:
+    struct Entry {
+        qint64 seq = 0;
+        QJsonObject payload;
+    };
+
+    static QString keyOf(const QJsonObject& payload);
+    void load();
+    void append(const QJsonObject& line);
+    /** @brief Rewrites the journal with only the pending entries */
+    void compact();
+    void acknowledge(const QString& key, qint64 seq);
+    void scheduleFlush(int delayMs);
+    void onFlushFinished();
+
+    QString m_path;
+    QString m_url;
+    QString m_token;
+    QNetworkAccessManager* m_network = nullptr;
+
+    QHash<QString, Entry> m_pending;  // newest update per profile/media
+    qint64 m_seq = 0;
+    int m_lines = 0;                  // lines in the journal file
+
+    QTimer* m_flushTimer;
+    int m_inFlight = 0;
+    bool m_flushFailed = false;
+    int m_failures = 0;               // flushes failed in a row, drives the backoff
+};
+
+#endif // PROGRESSJOURNAL_H
@@ -0,0 +1,160 @@
+#include "SegmentCache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+SegmentCache::SegmentCache(const QString& rootDir, qint64 capBytes)
+    : m_root(rootDir)
+    , m_cap(capBytes)
+{
+    QDir().mkpath(m_root);
+
+    // Rebuild the index; file modification times stand in for last use.
+    struct Found { QString key; qint64 bytes; qint64 modified; };
+    std::vector<Found> found;
+    QDirIterator it(m_root, QStringList{ "*.seg" }, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QFileInfo file(it.next());
+        const QString id = file.dir().dirName();
+        found.push_back({ id + "/" + file.completeBaseName(), file.size(),
+                          file.lastModified().toMSecsSinceEpoch() });
+    }
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.modified < b.modified; });
+    for (const Found& segment : found) {
+        m_segments.insert(segment.key, { segment.bytes, ++m_clock });
+        m_total += segment.bytes;
+    }
+
+    QDirIterator infos(m_root, QStringList{ "info.json" }, QDir::Files, QDirIterator::Subdirectories);
+    while (infos.hasNext()) {
+        const QString path = infos.next();
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+        const QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+        MediaInfo info;
+        info.size = json.value("size").toInteger(-1);
+        info.contentType = json.value("contentType").toString().toUtf8();
+        m_info.insert(QFileInfo(path).dir().dirName(), info);
+    }
+
+    fprintf(stderr, "[GHOST] stream cache: %lld MB in %d segments (cap %lld MB)\n",
+            static_cast<long long>(m_total >> 20), static_cast<int>(m_segments.size()),
+            static_cast<long long>(m_cap >> 20));
+    fflush(stderr);
+    evict();
+}
+
+bool SegmentCache::info(const QString& mediaId, MediaInfo& info) const {
+    auto it = m_info.constFind(safeId(mediaId));
+    if (it == m_info.constEnd() || it->size < 0)
+        return false;
+    info = *it;
+    return true;
+}
+
+void SegmentCache::setInfo(const QString& mediaId, const MediaInfo& info) {
+    const QString id = safeId(mediaId);
+    m_info.insert(id, info);
+    QDir().mkpath(m_root + "/" + id);
+    QSaveFile file(m_root + "/" + id + "/info.json");
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    QJsonObject json;
+    json["size"] = info.size;
+    json["contentType"] = QString::fromUtf8(info.contentType);
+    file.write(QJsonDocument(json).toJson(QJsonDocument::Compact));
+    file.commit();
+}
+
+bool SegmentCache::hasSegment(const QString& mediaId, qint64 index) const {
+    return m_segments.contains(key(mediaId, index));
+}
+
+QByteArray SegmentCache::readSegment(const QString& mediaId, qint64 index) {
+    const QString segmentKey = key(mediaId, index);
+    auto it = m_segments.find(segmentKey);
+    if (it == m_segments.end())
+        return QByteArray();
+    QFile file(segmentPath(mediaId, index));
+    QByteArray data;
+    if (file.open(QIODevice::ReadOnly))
+        data = file.readAll();
+    if (data.size() != it->bytes) {
+        // Removed or damaged behind our back: forget it, it will be refetched.
+        m_total -= it->bytes;
+        m_segments.erase(it);
+        file.remove();
+        return QByteArray();
+    }
+    // Recency survives a restart through the modification time.
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    touch(segmentKey);
+    return data;
+}
+
+void SegmentCache::writeSegment(const QString& mediaId, qint64 index, const QByteArray& data) {
+    if (data.isEmpty() || data.size() > kSegmentSize || m_cap <= 0)
+        return;
+    const QString segmentKey = key(mediaId, index);
+    if (m_segments.contains(segmentKey))
+        return;
+
+    QDir().mkpath(m_root + "/" + safeId(mediaId));
+    QSaveFile file(segmentPath(mediaId, index));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+        return;
+    m_segments.insert(segmentKey, { data.size(), ++m_clock });
+    m_total += data.size();
+    evict();
+}
+
+QString SegmentCache::safeId(const QString& mediaId) {
+    // Media IDs come from the server; keep them from escaping the cache dir.
+    QString id = mediaId;
+    id.replace(QRegularExpression("[^A-Za-z0-9_.-]"), "_");
+    return id;
+}
+
+QString SegmentCache::key(const QString& mediaId, qint64 index) {
+    return safeId(mediaId) + "/" + QString::number(index);
+}
+
+QString SegmentCache::segmentPath(const QString& mediaId, qint64 index) const {
+    return m_root + "/" + key(mediaId, index) + ".seg";
+}
+
+void SegmentCache::touch(const QString& segmentKey) {
+    auto it = m_segments.find(segmentKey);
+    if (it != m_segments.end())
+        it->lastUse = ++m_clock;
+}
+
+void SegmentCache::evict() {
+    if (m_total <= m_cap)
+        return;
+    // Down to 90%, so a full cache doesn't sort on every write.
+    const qint64 target = m_cap - m_cap / 10;
+    std::vector<std::pair<quint64, QString>> order;
+    order.reserve(m_segments.size());
+    for (auto it = m_segments.cbegin(); it != m_segments.cend(); ++it)
+        order.emplace_back(it->lastUse, it.key());
+    std::sort(order.begin(), order.end());
+
+    for (const auto& [lastUse, segmentKey] : order) {
+        if (m_total <= target)
+            break;
+        m_total -= m_segments.value(segmentKey).bytes;
+        m_segments.remove(segmentKey);
+        QFile::remove(m_root + "/" + segmentKey + ".seg");
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SEGMENTCACHE_H
+#define SEGMENTCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * @brief Sparse, size-capped disk cache of stream bytes
+ *
+ * A stream is cached in fixed kSegmentSize pieces, one file per piece
+ * under <root>/<media id>/, so any byte range that has been watched once
+ * can be served again without the rest of the file. Each media also keeps
+ * an info.json with its total size and content type. When the total goes
+ * over the cap, the least recently used segments of any media are
+ * removed. Not thread-safe: owned by the stream proxy's thread.
+ */
+class SegmentCache {
+public:
+    static constexpr qint64 kSegmentSize = 1024 * 1024;
+
+    struct MediaInfo {
+        qint64 size = -1;        // total bytes, -1 when unknown
+        QByteArray contentType;
+    };
+
+    /** @brief Opens (and indexes) the cache under rootDir, capped at capBytes */
+    SegmentCache(const QString& rootDir, qint64 capBytes);
+
+    bool info(const QString& mediaId, MediaInfo& info) const;
+    void setInfo(const QString& mediaId, const MediaInfo& info);
+
+    bool hasSegment(const QString& mediaId, qint64 index) const;
+    /** @brief Segment bytes, or an empty array if missing or unreadable */
+    QByteArray readSegment(const QString& mediaId, qint64 index);
+    /** @brief Stores a complete segment (the last one of a media may be short) */
+    void writeSegment(const QString& mediaId, qint64 index, const QByteArray& data);
+
+private:
+    struct Segment {
+        qint64 bytes = 0;
+        quint64 lastUse = 0;
+    };
+
+    static QString safeId(const QString& mediaId);
+    static QString key(const QString& mediaId, qint64 index);
+    QString segmentPath(const QString& mediaId, qint64 index) const;
+    void touch(const QString& key);
+    void evict();
+
+    QString m_root;
+    qint64 m_cap;
+    qint64 m_total = 0;
+    quint64 m_clock = 0;                // LRU order, higher is more recent
+    QHash<QString, Segment> m_segments; // "<safe id>/<index>"
+    QHash<QString, MediaInfo> m_info;   // safe id → info
+};
+
+#endif // SEGMENTCACHE_H
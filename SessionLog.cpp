@@ -0,0 +1,134 @@
+#include "SessionLog.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstdio>
+
+SessionLog::SessionLog() {
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dir);
+    m_path = dir + "/sessions.log";
+}
+
+void SessionLog::begin(const QString& mediaId) {
+    *this = SessionLog();
+    m_active = true;
+    m_mediaId = mediaId;
+    m_started = QDateTime::currentDateTimeUtc();
+    m_clock.start();
+}
+
+void SessionLog::recordPlaying() {
+    if (m_active && m_startupMs < 0)
+        m_startupMs = m_clock.elapsed();
+}
+
+void SessionLog::recordFirstFrame() {
+    if (m_active && m_firstFrameMs < 0)
+        m_firstFrameMs = m_clock.elapsed();
+}
+
+void SessionLog::recordStallStart() {
+    if (!m_active || m_stallClock.isValid())
+        return;
+    ++m_rebuffers;
+    m_stallClock.start();
+}
+
+void SessionLog::recordStallEnd() {
+    if (!m_stallClock.isValid())
+        return;
+    m_rebufferMs += m_stallClock.elapsed();
+    m_stallClock.invalidate();
+}
+
+void SessionLog::recordSeekStart() {
+    if (m_active)
+        m_seekClock.start();
+}
+
+void SessionLog::recordSeekSettled() {
+    if (!m_seekClock.isValid())
+        return;
+    const qint64 latency = m_seekClock.elapsed();
+    m_seekClock.invalidate();
+    ++m_seeks;
+    m_seekTotalMs += latency;
+    m_seekMaxMs = std::max(m_seekMaxMs, latency);
+}
+
+void SessionLog::recordBitrate(double kbps, double seconds) {
+    if (!m_active || kbps <= 0.0 || seconds <= 0.0)
+        return;
+    m_bitrateKbitTotal += kbps * seconds;
+    m_bitrateSeconds += seconds;
+}
+
+void SessionLog::recordError() {
+    if (m_active)
+        ++m_errors;
+}
+
+void SessionLog::finish(const QString& reason, const QVariantMap& streamStats, const QVariantMap& extra) {
+    if (!m_active)
+        return;
+    recordStallEnd();  // a stall still running counts up to now
+    m_active = false;
+
+    const qint64 durationMs = m_clock.elapsed();
+    const double averageKbps = m_bitrateSeconds > 0.0 ? m_bitrateKbitTotal / m_bitrateSeconds : 0.0;
+
+    QJsonObject session;
+    session["started"] = m_started.toString(Qt::ISODateWithMs);
+    session["mediaID"] = m_mediaId;
+    session["reason"] = reason;
+    session["durationMs"] = durationMs;
+    session["startupMs"] = m_startupMs;
+    session["timeToFirstFrameMs"] = m_firstFrameMs;
+    session["rebuffers"] = m_rebuffers;
+    session["rebufferMs"] = m_rebufferMs;
+    session["seeks"] = m_seeks;
+    session["seekMeanMs"] = m_seeks > 0 ? m_seekTotalMs / m_seeks : 0;
+    session["seekMaxMs"] = m_seekMaxMs;
+    session["averageBitrateKbps"] = qRound(averageKbps);
+    session["errors"] = m_errors;
+    for (auto it = streamStats.cbegin(); it != streamStats.cend(); ++it) {
+        // Rates at the last sample say little about the whole session.
+        if (!it.key().endsWith("Kbps"))
+            session[it.key()] = QJsonValue::fromVariant(it.value());
+    }
+    for (auto it = extra.cbegin(); it != extra.cend(); ++it)
+        session[it.key()] = QJsonValue::fromVariant(it.value());
+
+    append(QJsonDocument(session).toJson(QJsonDocument::Compact) + '\n');
+
+    fprintf(stderr, "[GHOST] session %s (%s): first frame %lld ms, %d rebuffer(s) for %lld ms,"
+                    " %d seek(s) avg %lld ms, %.0f kb/s\n",
+            m_mediaId.toUtf8().constData(), reason.toUtf8().constData(),
+            static_cast<long long>(m_firstFrameMs), m_rebuffers, static_cast<long long>(m_rebufferMs),
+            m_seeks, static_cast<long long>(m_seeks > 0 ? m_seekTotalMs / m_seeks : 0), averageKbps);
+    fflush(stderr);
+}
+
+void SessionLog::append(const QByteArray& line) {
+    if (QFileInfo(m_path).size() + line.size() > kMaxBytes)
+        rotate();
+    QFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        fprintf(stderr, "[GHOST] session log: cannot write %s\n", m_path.toUtf8().constData());
+        fflush(stderr);
+        return;
+    }
+    file.write(line);
+}
+
+void SessionLog::rotate() {
+    QFile::remove(m_path + "." + QString::number(kKeepFiles));
+    for (int i = kKeepFiles - 1; i >= 1; --i)
+        QFile::rename(m_path + "." + QString::number(i), m_path + "." + QString::number(i + 1));
+    QFile::rename(m_path, m_path + ".1");
+}
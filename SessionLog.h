@@ -0,0 +1,85 @@
+#ifndef SESSIONLOG_H
+#define SESSIONLOG_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVariantMap>
+
+/**
+ * @brief Quality-of-experience record of each playback session
+ *
+ * A session runs from the start of playback (loadMedia, or playMedia after
+ * the last session ended) until the media ends, is stopped, replaced or
+ * the player closes. The handler reports what it sees along the way:
+ * when playback started and the first frame reached the screen, every
+ * stall, every seek and the bitrate while playing. finish() appends one
+ * JSON line per session to AppDataLocation/sessions.log, together with
+ * the final libVLC input counters, so "it stutters" reports can be looked
+ * at offline. The file is rotated at kMaxBytes, keeping kKeepFiles older
+ * ones (sessions.log.1 is the newest).
+ */
+class SessionLog {
+public:
+    static constexpr qint64 kMaxBytes = 512 * 1024;
+    static constexpr int kKeepFiles = 3;
+
+    SessionLog();
+
+    /** @brief Starts recording a session for mediaId, dropping any unfinished one */
+    void begin(const QString& mediaId);
+
+    /** @brief True between begin() and finish() */
+    bool isActive() const { return m_active; }
+
+    /** @brief VLC reported Playing for the first time */
+    void recordPlaying();
+
+    /** @brief The first picture was handed to the video sink */
+    void recordFirstFrame();
+
+    void recordStallStart();
+    void recordStallEnd();
+
+    /** @brief A seek was sent to VLC; a seek still settling is replaced */
+    void recordSeekStart();
+    /** @brief Playback reported a position near the seek target */
+    void recordSeekSettled();
+
+    /** @brief Demuxed bitrate measured over seconds of normal playback */
+    void recordBitrate(double kbps, double seconds);
+
+    void recordError();
+
+    /**
+     * @brief Writes the session, if one is running, and ends it
+     * @param reason Why it ended, e.g. "end", "stop", "switch" or "close"
+     * @param streamStats Last VLCPlayerHandler::streamStats() of the media
+     * @param extra Further fields for the record
+     */
+    void finish(const QString& reason, const QVariantMap& streamStats, const QVariantMap& extra = {});
+
+private:
+    void append(const QByteArray& line);
+    void rotate();
+
+    QString m_path;
+    bool m_active = false;
+    QString m_mediaId;
+    QDateTime m_started;
+    QElapsedTimer m_clock;          // since begin()
+    qint64 m_startupMs = -1;
+    qint64 m_firstFrameMs = -1;
+    int m_rebuffers = 0;
+    qint64 m_rebufferMs = 0;
+    QElapsedTimer m_stallClock;     // valid while stalled
+    int m_seeks = 0;
+    qint64 m_seekTotalMs = 0;
+    qint64 m_seekMaxMs = 0;
+    QElapsedTimer m_seekClock;      // valid while a seek settles
+    double m_bitrateKbitTotal = 0.0;  // kb/s × seconds
+    double m_bitrateSeconds = 0.0;
+    int m_errors = 0;
+};
+
+#endif // SESSIONLOG_H
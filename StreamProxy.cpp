@@ -0,0 +1,456 @@
+#include "StreamProxy.h"
+#include "SegmentCache.h"
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <memory>
+
+namespace {
+constexpr qint64 kSegment = SegmentCache::kSegmentSize;
+// Segments asked for in one upstream request.
+constexpr qint64 kFetchSegments = 8;
+// VLC reads at playback speed; don't queue more than this on its socket.
+constexpr qint64 kSocketHighWater = 4 * 1024 * 1024;
+// Upstream failures in a row before a connection gives up.
+constexpr int kMaxFetchFailures = 3;
+// Shorter bodies say more about latency than about throughput.
+constexpr qint64 kMinSampleMs = 50;
+}
+
+/**
+ * @brief Listening socket, upstream network access and cache (proxy thread)
+ */
+class ProxyServer : public QObject {
+public:
+    ProxyServer(StreamProxy& owner, const QString& serverUrl, const QString& token, const QString& cacheDir,
+                qint64 capBytes, const QString& secret)
+        : m_owner(owner)
+        , m_serverUrl(serverUrl)
+        , m_authorization("Bearer " + token.toUtf8())
+        , m_cacheDir(cacheDir)
+        , m_capBytes(capBytes)
+        , m_secret(secret)
+    {
+        connect(&m_listener, &QTcpServer::newConnection, this, &ProxyServer::acceptConnections);
+    }
+
+    ~ProxyServer() override {
+        // Connections first: they still use the cache and network manager.
+        const QObjectList connections = children();
+        qDeleteAll(connections);
+    }
+
+    quint16 listen() {
+        return m_listener.listen(QHostAddress::LocalHost, 0) ? m_listener.serverPort() : 0;
+    }
+
+    // Indexed on first use, so start() doesn't wait for the directory scan.
+    SegmentCache& cache() {
+        if (!m_cache)
+            m_cache = std::make_unique<SegmentCache>(m_cacheDir, m_capBytes);
+        return *m_cache;
+    }
+
+    QNetworkAccessManager& network() { return m_network; }
+    const QString& serverUrl() const { return m_serverUrl; }
+    const QByteArray& authorization() const { return m_authorization; }
+    const QString& secret() const { return m_secret; }
+
+    void reportUpstream(qint64 connectMs, double kbps) { emit m_owner.upstreamSample(connectMs, kbps); }
+
+private:
+    void acceptConnections();
+
+    StreamProxy& m_owner;
+    QTcpServer m_listener;
+    QNetworkAccessManager m_network;
+    std::unique_ptr<SegmentCache> m_cache;
+    QString m_serverUrl;
+    QByteArray m_authorization;
+    QString m_cacheDir;
+    qint64 m_capBytes;
+    QString m_secret;
+};
+
+/**
+ * @brief One request from VLC: answers a byte range from cache and upstream
+ *
+ * Sends whole segments to the socket in order, from the cache when they are
+ * there and otherwise from an upstream range request covering the next run
+ * of missing segments. Each segment that arrives is cached as soon as it is
+ * complete. Connection: close, so every seek is a new ProxyConnection.
+ */
+class ProxyConnection : public QObject {
+public:
+    ProxyConnection(ProxyServer& server, QTcpSocket* socket)
+        : QObject(&server)
+        , m_server(server)
+        , m_socket(socket)
+    {
+        socket->setParent(this);
+        connect(socket, &QTcpSocket::readyRead, this, [this]() { readRequest(); });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this]() { pump(); });
+        connect(socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+    }
+
+    ~ProxyConnection() override {
+        // VLC went away (seek, stop): complete segments are already cached.
+        if (m_fetch) {
+            m_fetch->disconnect(this);
+            m_fetch->abort();
+        }
+    }
+
+private:
+    void readRequest();
+    void pump();
+    bool haveSegment(qint64 index) const;
+    void startFetch(qint64 index);
+    bool readFetchHeaders();
+    void onFetchData();
+    void onFetchFinished();
+    void storeSegment(qint64 index, const QByteArray& data);
+    void respondError(int status, const char* reason);
+    /** @brief Closes the connection once queued data is sent */
+    void finish();
+
+    ProxyServer& m_server;
+    QTcpSocket* m_socket;
+    QByteArray m_request;
+    bool m_requestDone = false;
+
+    QString m_mediaId;
+    bool m_head = false;
+    bool m_hasRange = false;
+    qint64 m_start = 0;
+    qint64 m_end = -1;          // inclusive, -1 until the size is known
+    qint64 m_pos = 0;
+    bool m_headersSent = false;
+    bool m_finished = false;
+
+    QPointer<QNetworkReply> m_fetch;
+    bool m_fetchHeadersRead = false;
+    qint64 m_fetchSegment = 0;  // segment the fetch buffer belongs to
+    qint64 m_fetchLast = 0;     // last segment the fetch was asked for
+    QByteArray m_fetchBuffer;
+    QElapsedTimer m_fetchClock;     // since the upstream request was sent
+    qint64 m_fetchConnectMs = -1;   // until its first data, -1 before that
+    qint64 m_fetchBytes = 0;        // body bytes received
+    int m_fetchFailures = 0;
+    QHash<qint64, QByteArray> m_fresh;  // fetched segments not sent yet
+};
+
+void ProxyServer::acceptConnections() {
+    while (QTcpSocket* socket = m_listener.nextPendingConnection())
+        new ProxyConnection(*this, socket);
+}
+
+void ProxyConnection::readRequest() {
+    if (m_requestDone) {
+        m_socket->readAll();
+        return;
+    }
+    m_request += m_socket->readAll();
+    const qsizetype headerEnd = m_request.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (m_request.size() > 16 * 1024)
+            respondError(431, "Request Header Fields Too Large");
+        return;
+    }
+    m_requestDone = true;
+
+    const QList<QByteArray> lines = m_request.left(headerEnd).split('\n');
+    const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+    const QByteArray method = requestLine.value(0);
+    const QString prefix = "/" + m_server.secret() + "/stream/";
+    const QString path = QUrl::fromPercentEncoding(requestLine.value(1));
+    if ((method != "GET" && method != "HEAD") || !path.startsWith(prefix) || path.size() == prefix.size()) {
+        respondError(404, "Not Found");
+        return;
+    }
+    m_mediaId = path.mid(prefix.size());
+    m_head = method == "HEAD";
+
+    static const QRegularExpression range("^bytes=(\\d+)-(\\d*)$");
+    for (const QByteArray& line : lines) {
+        const qsizetype colon = line.indexOf(':');
+        if (colon < 0 || line.left(colon).trimmed().toLower() != "range")
+            continue;
+        // Suffix ranges (bytes=-N) and lists aren't used by VLC; serve all.
+        const QRegularExpressionMatch match = range.match(QString::fromLatin1(line.mid(colon + 1).trimmed()));
+        if (match.hasMatch()) {
+            m_hasRange = true;
+            m_start = match.captured(1).toLongLong();
+            m_end = match.captured(2).isEmpty() ? -1 : match.captured(2).toLongLong();
+        }
+    }
+    pump();
+}
+
+void ProxyConnection::pump() {
+    if (!m_requestDone || m_finished || m_mediaId.isEmpty())
+        return;
+    SegmentCache& cache = m_server.cache();
+
+    if (!m_headersSent) {
+        SegmentCache::MediaInfo info;
+        if (!cache.info(m_mediaId, info)) {
+            // The size comes with the first upstream response.
+            if (!m_fetch)
+                startFetch(m_start / kSegment);
+            return;
+        }
+        if (m_start >= info.size || (m_end >= 0 && m_end < m_start)) {
+            respondError(416, "Range Not Satisfiable");
+            return;
+        }
+        m_end = m_end < 0 ? info.size - 1 : std::min(m_end, info.size - 1);
+        QByteArray headers = m_hasRange ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n";
+        headers += "Content-Type: " + (info.contentType.isEmpty() ? QByteArray("application/octet-stream")
+                                                                  : info.contentType) + "\r\n";
+        headers += "Content-Length: " + QByteArray::number(m_end - m_start + 1) + "\r\n";
+        if (m_hasRange) {
+            headers += "Content-Range: bytes " + QByteArray::number(m_start) + "-" + QByteArray::number(m_end)
+                     + "/" + QByteArray::number(info.size) + "\r\n";
+        }
+        headers += "Accept-Ranges: bytes\r\nConnection: close\r\n\r\n";
+        m_socket->write(headers);
+        m_headersSent = true;
+        m_pos = m_start;
+        if (m_head) {
+            finish();
+            return;
+        }
+    }
+
+    while (m_pos <= m_end && m_socket->bytesToWrite() < kSocketHighWater) {
+        const qint64 index = m_pos / kSegment;
+        QByteArray data = m_fresh.take(index);
+        if (data.isEmpty())
+            data = cache.readSegment(m_mediaId, index);
+        if (data.isEmpty()) {
+            if (!m_fetch)
+                startFetch(index);
+            return;
+        }
+        const qint64 from = m_pos - index * kSegment;
+        const qint64 to = std::min<qint64>(m_end + 1 - index * kSegment, data.size());
+        if (to <= from) {
+            // Cached segment shorter than the size says: stale cache entry.
+            finish();
+            return;
+        }
+        m_socket->write(data.constData() + from, to - from);
+        m_pos += to - from;
+    }
+
+    if (m_pos > m_end) {
+        finish();
+        return;
+    }
+    // Fetch ahead while VLC drains what is queued.
+    const qint64 next = m_pos / kSegment;
+    if (!m_fetch && !haveSegment(next))
+        startFetch(next);
+}
+
+bool ProxyConnection::haveSegment(qint64 index) const {
+    return m_fresh.contains(index) || m_server.cache().hasSegment(m_mediaId, index);
+}
+
+void ProxyConnection::startFetch(qint64 index) {
+    if (m_fetchFailures >= kMaxFetchFailures) {
+        if (m_headersSent)
+            finish();  // VLC reconnects with http-reconnect
+        else
+            respondError(502, "Bad Gateway");
+        return;
+    }
+
+    SegmentCache::MediaInfo info;
+    const bool sizeKnown = m_server.cache().info(m_mediaId, info);
+    const qint64 lastSegment = sizeKnown ? (info.size - 1) / kSegment : std::numeric_limits<qint64>::max();
+    const qint64 wanted = std::min(lastSegment, m_end >= 0 ? m_end / kSegment : lastSegment);
+    qint64 last = index;
+    while (last < wanted && last + 1 - index < kFetchSegments && !haveSegment(last + 1))
+        ++last;
+    qint64 rangeEnd = (last + 1) * kSegment - 1;
+    if (sizeKnown)
+        rangeEnd = std::min(rangeEnd, info.size - 1);
+
+    QNetworkRequest request(QUrl(m_server.serverUrl() + "/stream/" + m_mediaId));
+    request.setRawHeader("Authorization", m_server.authorization());
+    request.setRawHeader("Range", "bytes=" + QByteArray::number(index * kSegment) + "-" + QByteArray::number(rangeEnd));
+    m_fetch = m_server.network().get(request);
+    m_fetchHeadersRead = false;
+    m_fetchSegment = index;
+    m_fetchLast = last;
+    m_fetchBuffer.clear();
+    m_fetchClock.start();
+    m_fetchConnectMs = -1;
+    m_fetchBytes = 0;
+    connect(m_fetch, &QNetworkReply::readyRead, this, [this]() { onFetchData(); });
+    connect(m_fetch, &QNetworkReply::finished, this, [this]() { onFetchFinished(); });
+}
+
+bool ProxyConnection::readFetchHeaders() {
+    const int status = m_fetch->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    const qint64 offset = m_fetchSegment * kSegment;
+    qint64 total = -1;
+    if (status == 206) {
+        // Content-Range: bytes <first>-<last>/<total>
+        static const QRegularExpression contentRange("bytes\\s+(\\d+)-(\\d+)/(\\d+)");
+        const QRegularExpressionMatch match =
+            contentRange.match(QString::fromLatin1(m_fetch->rawHeader("Content-Range")));
+        if (!match.hasMatch() || match.captured(1).toLongLong() != offset)
+            return false;
+        total = match.captured(3).toLongLong();
+    } else if (status == 200 && offset == 0) {
+        // No range support upstream; the body is the whole file.
+        total = m_fetch->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    } else {
+        return false;
+    }
+
+    SegmentCache::MediaInfo known;
+    if (total > 0 && !m_server.cache().info(m_mediaId, known)) {
+        SegmentCache::MediaInfo info;
+        info.size = total;
+        info.contentType = m_fetch->rawHeader("Content-Type");
+        m_server.cache().setInfo(m_mediaId, info);
+    }
+    return total > 0;
+}
+
+void ProxyConnection::onFetchData() {
+    if (!m_fetchHeadersRead) {
+        if (!readFetchHeaders()) {
+            fprintf(stderr, "[GHOST] stream proxy: unexpected upstream response for %s\n",
+                    m_mediaId.toUtf8().constData());
+            fflush(stderr);
+            m_fetchFailures = kMaxFetchFailures;
+            m_fetch->abort();
+            return;
+        }
+        m_fetchHeadersRead = true;
+        m_fetchConnectMs = m_fetchClock.elapsed();
+    }
+
+    const QByteArray data = m_fetch->readAll();
+    m_fetchBytes += data.size();
+    m_fetchBuffer += data;
+    while (m_fetchBuffer.size() >= kSegment && m_fetchSegment <= m_fetchLast) {
+        storeSegment(m_fetchSegment++, m_fetchBuffer.left(kSegment));
+        m_fetchBuffer.remove(0, kSegment);
+    }
+    // A server without range support keeps sending; stop at the run's end.
+    if (m_fetchSegment > m_fetchLast) {
+        m_fetchBuffer.clear();
+        m_fetch->abort();
+        return;
+    }
+    pump();
+}
+
+void ProxyConnection::onFetchFinished() {
+    QNetworkReply* reply = m_fetch;
+    if (!reply)
+        return;
+    const bool ok = reply->error() == QNetworkReply::NoError || m_fetchSegment > m_fetchLast;
+
+    // The file's last segment is shorter than the others.
+    SegmentCache::MediaInfo info;
+    if (ok && !m_fetchBuffer.isEmpty() && m_server.cache().info(m_mediaId, info)
+        && m_fetchSegment * kSegment + m_fetchBuffer.size() == info.size) {
+        storeSegment(m_fetchSegment, m_fetchBuffer);
+    }
+    m_fetchBuffer.clear();
+    if (ok && m_fetchConnectMs >= 0) {
+        const qint64 bodyMs = m_fetchClock.elapsed() - m_fetchConnectMs;
+        m_server.reportUpstream(m_fetchConnectMs, bodyMs >= kMinSampleMs ? m_fetchBytes * 8.0 / bodyMs : 0.0);
+    }
+    m_fetchFailures = ok ? 0 : m_fetchFailures + 1;
+    if (!ok) {
+        fprintf(stderr, "[GHOST] stream proxy: upstream fetch failed: %s\n",
+                reply->errorString().toUtf8().constData());
+        fflush(stderr);
+    }
+    reply->deleteLater();
+    m_fetch = nullptr;
+    pump();
+}
+
+void ProxyConnection::storeSegment(qint64 index, const QByteArray& data) {
+    m_server.cache().writeSegment(m_mediaId, index, data);
+    // Kept in memory too, in case the cache is full or the write failed.
+    if (index >= m_pos / kSegment)
+        m_fresh.insert(index, data);
+}
+
+void ProxyConnection::respondError(int status, const char* reason) {
+    if (!m_headersSent) {
+        m_socket->write("HTTP/1.1 " + QByteArray::number(status) + " " + reason
+                        + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        m_headersSent = true;
+    }
+    finish();
+}
+
+void ProxyConnection::finish() {
+    m_finished = true;
+    m_socket->disconnectFromHost();
+}
+
+StreamProxy::StreamProxy(QObject* parent)
+    : QObject(parent)
+{
+    m_thread.setObjectName("StreamProxy");
+}
+
+StreamProxy::~StreamProxy() {
+    if (m_thread.isRunning()) {
+        // Sockets and replies must be destroyed on the thread that owns them.
+        QMetaObject::invokeMethod(m_server, [server = m_server]() { delete server; },
+                                  Qt::BlockingQueuedConnection);
+        m_thread.quit();
+        m_thread.wait();
+    }
+}
+
+bool StreamProxy::start(const QString& serverUrl, const QString& token, const QString& cacheDir, qint64 capBytes) {
+    if (m_thread.isRunning())
+        return isRunning();
+    m_secret = QString::number(QRandomGenerator::system()->generate64(), 36);
+    m_thread.start();
+
+    // Created on the proxy thread so its sockets and network manager live there.
+    auto* context = new QObject;
+    context->moveToThread(&m_thread);
+    QMetaObject::invokeMethod(context, [&, context]() {
+        m_server = new ProxyServer(*this, serverUrl, token, cacheDir, capBytes, m_secret);
+        m_port = m_server->listen();
+        context->deleteLater();
+    }, Qt::BlockingQueuedConnection);
+
+    fprintf(stderr, "[GHOST] stream proxy: %s\n",
+            m_port ? QString("listening on 127.0.0.1:%1").arg(m_port).toUtf8().constData() : "failed to listen");
+    fflush(stderr);
+    return isRunning();
+}
+
+QString StreamProxy::streamUrl(const QString& mediaId) const {
+    return QString("http://127.0.0.1:%1/%2/stream/%3")
+        .arg(m_port)
+        .arg(m_secret, QString::fromUtf8(QUrl::toPercentEncoding(mediaId)));
+}
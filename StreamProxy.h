@@ -0,0 +1,61 @@
+#ifndef STREAMPROXY_H
+#define STREAMPROXY_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+
+class ProxyServer;
+
+/**
+ * @brief Loopback HTTP proxy that caches stream byte ranges on disk
+ *
+ * VLC opens http://127.0.0.1:<port>/<secret>/stream/<id> instead of the
+ * server. Every range it asks for is served from a SegmentCache where
+ * possible; only the missing segments are fetched from the server, with
+ * the bearer token attached, and kept for the next seek back, resume or
+ * replay. The secret path keeps other local programs from using the
+ * token through the proxy.
+ *
+ * Sockets, upstream requests and cache I/O all run on the proxy's own
+ * thread; this object only starts it, builds URLs and reports how the
+ * upstream requests went (VLC itself only ever sees the loopback).
+ */
+class StreamProxy : public QObject {
+    Q_OBJECT
+
+public:
+    explicit StreamProxy(QObject* parent = nullptr);
+    ~StreamProxy();
+
+    /**
+     * @brief Starts listening on a free loopback port
+     * @param serverUrl Base URL of the server streams are fetched from
+     * @param token Bearer token for upstream requests
+     * @param cacheDir Directory of the segment cache
+     * @param capBytes Size the cache is trimmed to, least recently used first
+     * @return false if no port could be opened; use the server directly then
+     */
+    bool start(const QString& serverUrl, const QString& token, const QString& cacheDir, qint64 capBytes);
+
+    bool isRunning() const { return m_port != 0; }
+
+    /** @brief URL VLC should open for mediaId */
+    QString streamUrl(const QString& mediaId) const;
+
+signals:
+    /**
+     * @brief An upstream range request completed (emitted on the proxy thread)
+     * @param connectMs Request sent to first response data
+     * @param kbps Body rate after that; 0 if it finished too quickly to tell
+     */
+    void upstreamSample(qint64 connectMs, double kbps);
+
+private:
+    QThread m_thread;
+    ProxyServer* m_server = nullptr;  // lives on m_thread
+    quint16 m_port = 0;
+    QString m_secret;
+};
+
+#endif // STREAMPROXY_H
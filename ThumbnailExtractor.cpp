@@ -0,0 +1,292 @@
+#include "ThumbnailExtractor.h"
+#include "VlcInstance.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+// Shortest gap between two seeks, even when the budget would allow more.
+constexpr int kMinGapMs = 250;
+// Longest wait for the picture of one position.
+constexpr int kSampleTimeoutMs = 8000;
+}
+
+ThumbnailExtractor::ThumbnailExtractor(QObject* parent)
+    : QObject(parent)
+{
+    m_nextTimer = new QTimer(this);
+    m_nextTimer->setSingleShot(true);
+    connect(m_nextTimer, &QTimer::timeout, this, &ThumbnailExtractor::extractNext);
+
+    m_sampleTimeout = new QTimer(this);
+    m_sampleTimeout->setSingleShot(true);
+    m_sampleTimeout->setInterval(kSampleTimeoutMs);
+    connect(m_sampleTimeout, &QTimer::timeout, this, &ThumbnailExtractor::onSampleTimeout);
+
+    m_encoder.setMaxThreadCount(1);
+    m_encoder.setThreadPriority(QThread::LowestPriority);
+}
+
+ThumbnailExtractor::~ThumbnailExtractor() {
+    releasePlayer();
+    m_encoder.waitForDone();
+    if (m_vlcInstance)
+        libvlc_release(m_vlcInstance);
+}
+
+void ThumbnailExtractor::start(const QString& mediaId, const QString& location, const QStringList& options,
+                               qint64 lengthMs) {
+    if (mediaId == m_mediaId && lengthMs == m_length && (m_player || m_next >= m_order.size()))
+        return;  // already running, or finished, for this media
+    stop();
+    if (lengthMs <= 0)
+        return;
+
+    m_mediaId = mediaId;
+    m_length = lengthMs;
+    QString safeId = mediaId;
+    safeId.replace(QRegularExpression("[^A-Za-z0-9_.-]"), "_");
+    m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails/" + safeId;
+    QDir().mkpath(m_cacheDir);
+
+    // Earlier runs may have left part of the set on disk.
+    m_ready.assign(kCount, false);
+    for (int i = 0; i < kCount; ++i) {
+        if (QFileInfo::exists(thumbnailPath(i))) {
+            m_ready[i] = true;
+            ++m_available;
+        }
+    }
+    emit thumbnailsChanged();
+
+    // Coarse to fine: every 64th position, then every 32nd, ...
+    m_order.clear();
+    std::vector<bool> queued(kCount, false);
+    int step = 1;
+    while (step * 2 < kCount) step *= 2;
+    for (; step >= 1; step /= 2) {
+        for (int i = 0; i < kCount; i += step) {
+            if (!queued[i]) {
+                queued[i] = true;
+                m_order.push_back(i);
+            }
+        }
+    }
+    m_next = 0;
+
+    if (m_available == kCount)
+        return;
+
+    if (!m_vlcInstance) {
+        m_vlcInstance = VlcInstance::acquire();
+        if (!m_vlcInstance) {
+            fprintf(stderr, "[GHOST] thumbnails: no VLC instance\n"); fflush(stderr);
+            return;
+        }
+    }
+    m_media = libvlc_media_new_location(m_vlcInstance, location.toUtf8().constData());
+    if (!m_media)
+        return;
+    for (const QString& option : options)
+        libvlc_media_add_option(m_media, option.toUtf8().constData());
+    // Keyframes only, one decoder thread, fast (keyframe) seeks, and a
+    // small cache so each seek reads little beyond the picture it needs.
+    libvlc_media_add_option(m_media, ":no-audio");
+    libvlc_media_add_option(m_media, ":no-spu");
+    libvlc_media_add_option(m_media, ":no-osd");
+    libvlc_media_add_option(m_media, ":avcodec-hw=none");
+    libvlc_media_add_option(m_media, ":avcodec-skip-frame=3");
+    libvlc_media_add_option(m_media, ":avcodec-threads=1");
+    libvlc_media_add_option(m_media, ":input-fast-seek");
+    libvlc_media_add_option(m_media, ":network-caching=1000");
+
+    fprintf(stderr, "[GHOST] thumbnails: %d of %d cached for %s\n", m_available, kCount, mediaId.toUtf8().constData());
+    fflush(stderr);
+    m_nextTimer->start(0);
+}
+
+void ThumbnailExtractor::stop() {
+    releasePlayer();
+    m_nextTimer->stop();
+    m_sampleTimeout->stop();
+    m_sampling = false;
+    m_mediaId.clear();
+    m_length = 0;
+    m_order.clear();
+    m_next = 0;
+    m_ready.clear();
+    if (m_available) {
+        m_available = 0;
+        emit thumbnailsChanged();
+    }
+}
+
+void ThumbnailExtractor::setPaused(bool paused) {
+    if (paused == m_paused)
+        return;
+    m_paused = paused;
+    // A seek already in flight finishes; the next one waits until unpaused.
+    if (!m_paused && m_media && !m_sampling && !m_nextTimer->isActive())
+        m_nextTimer->start(throttleDelayMs());
+}
+
+QUrl ThumbnailExtractor::thumbnailAt(qint64 position) const {
+    if (m_length <= 0 || m_available == 0)
+        return QUrl();
+    const int ideal = std::clamp(static_cast<int>(position * kCount / m_length), 0, kCount - 1);
+    for (int distance = 0; distance < kCount; ++distance) {
+        if (ideal - distance >= 0 && m_ready[ideal - distance])
+            return QUrl::fromLocalFile(thumbnailPath(ideal - distance));
+        if (ideal + distance < kCount && m_ready[ideal + distance])
+            return QUrl::fromLocalFile(thumbnailPath(ideal + distance));
+    }
+    return QUrl();
+}
+
+void ThumbnailExtractor::extractNext() {
+    if (!m_media || m_paused || m_sampling)
+        return;
+    while (m_next < m_order.size() && m_ready[m_order[m_next]])
+        ++m_next;
+    if (m_next >= m_order.size()) {
+        fprintf(stderr, "[GHOST] thumbnails: done for %s\n", m_mediaId.toUtf8().constData()); fflush(stderr);
+        releasePlayer();
+        return;
+    }
+
+    const int index = m_order[m_next++];
+    const qint64 time = (2 * index + 1) * m_length / (2 * kCount);  // middle of each slot
+    m_sampling = true;
+    m_sampleIndex.store(index);
+
+    if (!m_player) {
+        // libVLC 3 can't seek before the input runs, so the first position
+        // is the start time.
+        libvlc_media_add_option(m_media, QString(":start-time=%1").arg(time / 1000.0).toUtf8().constData());
+        m_player = libvlc_media_player_new_from_media(m_media);
+        if (!m_player) {
+            m_sampling = false;
+            return;
+        }
+        libvlc_video_set_format_callbacks(m_player, &ThumbnailExtractor::formatCallback, nullptr);
+        libvlc_video_set_callbacks(m_player, &ThumbnailExtractor::lockCallback, nullptr,
+                                   &ThumbnailExtractor::displayCallback, this);
+        m_runClock.start();
+        libvlc_media_player_play(m_player);
+    } else {
+        // Paused since the previous picture, so nothing older than the
+        // seek reaches the display callback.
+        libvlc_media_player_set_time(m_player, time);
+        libvlc_media_player_set_pause(m_player, 0);
+    }
+    m_sampleTimeout->start();
+}
+
+void ThumbnailExtractor::onSampleTimeout() {
+    m_sampling = false;
+    m_sampleIndex.store(-1);
+    const libvlc_state_t state = m_player ? libvlc_media_player_get_state(m_player) : libvlc_Error;
+    if (state == libvlc_Error || state == libvlc_Ended) {
+        fprintf(stderr, "[GHOST] thumbnails: stream failed, giving up\n"); fflush(stderr);
+        releasePlayer();
+        return;
+    }
+    libvlc_media_player_set_pause(m_player, 1);
+    m_nextTimer->start(throttleDelayMs());
+}
+
+void ThumbnailExtractor::onFrame(int index, const QImage& image) {
+    if (!m_sampling || !m_player)
+        return;
+    m_sampling = false;
+    m_sampleTimeout->stop();
+    libvlc_media_player_set_pause(m_player, 1);
+
+    const QString mediaId = m_mediaId;
+    const QString path = thumbnailPath(index);
+    m_encoder.start([this, image, path, mediaId, index]() {
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "JPG", 75) || !file.commit())
+            return;
+        QMetaObject::invokeMethod(this, [this, mediaId, index]() {
+            if (mediaId != m_mediaId || m_ready[index])
+                return;
+            m_ready[index] = true;
+            ++m_available;
+            emit thumbnailsChanged();
+        }, Qt::QueuedConnection);
+    });
+
+    if (!m_paused)
+        m_nextTimer->start(throttleDelayMs());
+}
+
+int ThumbnailExtractor::throttleDelayMs() const {
+    libvlc_media_stats_t stats;
+    if (!m_media || !m_runClock.isValid() || m_budgetKbps <= 0.0 || !libvlc_media_get_stats(m_media, &stats))
+        return kMinGapMs;
+    // bits / (kbit/s) = ms the bytes read so far are allowed to take.
+    const qint64 allowedMs = static_cast<qint64>(stats.i_read_bytes * 8.0 / m_budgetKbps);
+    return static_cast<int>(std::clamp<qint64>(allowedMs - m_runClock.elapsed(), kMinGapMs, 60000));
+}
+
+void ThumbnailExtractor::releasePlayer() {
+    if (m_player) {
+        // Synchronous: the video thread is gone once this returns.
+        libvlc_media_player_stop(m_player);
+        libvlc_media_player_release(m_player);
+        m_player = nullptr;
+    }
+    if (m_media) {
+        libvlc_media_release(m_media);
+        m_media = nullptr;
+    }
+    m_sampleIndex.store(-1);
+    m_runClock.invalidate();
+}
+
+QString ThumbnailExtractor::thumbnailPath(int index) const {
+    return m_cacheDir + "/" + QString::number(index) + ".jpg";
+}
+
+unsigned ThumbnailExtractor::formatCallback(void** opaque, char* chroma, unsigned* width, unsigned* height,
+                                            unsigned* pitches, unsigned* lines) {
+    auto* self = static_cast<ThumbnailExtractor*>(*opaque);
+    // VLC's video thread for this player; keep it out of the way of the
+    // main player's.
+    QThread::currentThread()->setPriority(QThread::LowestPriority);
+
+    // VLC scales to whatever size is asked for here.
+    const unsigned sourceWidth = std::max(1u, *width);
+    const unsigned thumbHeight = std::max(2u, (kWidth * *height / sourceWidth) & ~1u);
+    memcpy(chroma, "RV32", 4);
+    *width = kWidth;
+    *height = thumbHeight;
+    pitches[0] = kWidth * 4;
+    lines[0] = thumbHeight;
+    self->m_frame = QImage(kWidth, static_cast<int>(thumbHeight), QImage::Format_RGB32);
+    return 1;
+}
+
+void* ThumbnailExtractor::lockCallback(void* opaque, void** planes) {
+    auto* self = static_cast<ThumbnailExtractor*>(opaque);
+    planes[0] = self->m_frame.bits();
+    return nullptr;
+}
+
+void ThumbnailExtractor::displayCallback(void* opaque, void* /*picture*/) {
+    auto* self = static_cast<ThumbnailExtractor*>(opaque);
+    const int index = self->m_sampleIndex.exchange(-1);
+    if (index < 0)
+        return;
+    const QImage image = self->m_frame.copy();
+    QMetaObject::invokeMethod(self, [self, index, image]() {
+        self->onFrame(index, image);
+    }, Qt::QueuedConnection);
+}
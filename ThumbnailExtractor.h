@@ -0,0 +1,115 @@
+#ifndef THUMBNAILEXTRACTOR_H
+#define THUMBNAILEXTRACTOR_H
+
+#include <vlc/vlc.h>
+#include <QObject>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief Builds seek-bar preview thumbnails for a stream in the background
+ *
+ * Opens the stream a second time on its own player of the shared libVLC
+ * instance, without audio or subtitles, decoding keyframes only on a
+ * single thread. VLC scales each picture to kWidth pixels wide before the video callbacks
+ * see it. kCount evenly spaced positions are visited coarse to fine, so a
+ * usable set exists early. Each thumbnail is a small JPEG written to
+ * CacheLocation/thumbnails/<media id>/, encoded at the lowest thread
+ * priority; a later run for the same media only fetches what is missing.
+ *
+ * Network use is kept below a budget by spacing the seeks, and the owner
+ * pauses extraction whenever the main stream needs the link.
+ */
+class ThumbnailExtractor : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int kCount = 100;  // thumbnails per media
+    static constexpr int kWidth = 192;  // thumbnail width in pixels
+
+    explicit ThumbnailExtractor(QObject* parent = nullptr);
+    ~ThumbnailExtractor();
+
+    /**
+     * @brief Starts extracting thumbnails for a stream
+     * @param mediaId Key of the on-disk cache
+     * @param location Stream URL
+     * @param options Media options (e.g. the auth header) applied to the stream
+     * @param lengthMs Media length the positions are spread over
+     */
+    void start(const QString& mediaId, const QString& location, const QStringList& options, qint64 lengthMs);
+
+    /** @brief Stops extraction and forgets the current media */
+    void stop();
+
+    /** @brief Holds extraction between thumbnails, e.g. while the main stream buffers */
+    void setPaused(bool paused);
+
+    /** @brief Caps the average read rate of the extraction stream */
+    void setBandwidthLimit(double kbps) { m_budgetKbps = kbps; }
+
+    /** @brief Thumbnails available for the current media */
+    int available() const { return m_available; }
+
+    /** @brief File URL of the ready thumbnail closest to position, or empty */
+    QUrl thumbnailAt(qint64 position) const;
+
+signals:
+    /** @brief Emitted whenever a thumbnail becomes available */
+    void thumbnailsChanged();
+
+private slots:
+    /** @brief Seeks to the next missing position, or finishes */
+    void extractNext();
+    /** @brief Gives up on a position that produced no picture */
+    void onSampleTimeout();
+
+private:
+    static unsigned formatCallback(void** opaque, char* chroma, unsigned* width, unsigned* height,
+                                   unsigned* pitches, unsigned* lines);
+    static void* lockCallback(void* opaque, void** planes);
+    static void displayCallback(void* opaque, void* picture);
+
+    /** @brief A picture arrived for the position being sampled (GUI thread) */
+    void onFrame(int index, const QImage& image);
+    /** @brief Delay before the next seek that keeps reads under the budget */
+    int throttleDelayMs() const;
+    void releasePlayer();
+    QString thumbnailPath(int index) const;
+
+    libvlc_instance_t* m_vlcInstance = nullptr;  // retained VlcInstance
+    libvlc_media_player_t* m_player = nullptr;
+    libvlc_media_t* m_media = nullptr;
+
+    QString m_mediaId;
+    QString m_cacheDir;
+    qint64 m_length = 0;
+    std::vector<int> m_order;     // indices, coarse to fine
+    size_t m_next = 0;            // position in m_order
+    std::vector<bool> m_ready;    // per index, thumbnail on disk
+    int m_available = 0;
+    bool m_paused = false;
+    bool m_sampling = false;      // a seek is waiting for its picture
+    QTimer* m_nextTimer;
+    QTimer* m_sampleTimeout;
+
+    double m_budgetKbps = 1500.0;
+    QElapsedTimer m_runClock;     // since the extraction stream opened
+
+    // Written by VLC on this player's video thread only. m_sampleIndex is
+    // the position the next picture belongs to, -1 once it has been taken.
+    QImage m_frame;
+    std::atomic<int> m_sampleIndex{ -1 };
+
+    // JPEG encoding and file writes, off the GUI thread at lowest priority.
+    QThreadPool m_encoder;
+};
+
+#endif // THUMBNAILEXTRACTOR_H
@@ -0,0 +1,81 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Lock-free single-producer / single-consumer triple buffer
+ *
+ * The producer always owns one slot to write into and the consumer always
+ * owns one slot to read from. The third slot sits in between and is swapped
+ * atomically: publish() hands the freshly written slot over, fetch() takes
+ * the newest published one. Neither side ever waits for the other.
+ *
+ * When the producer publishes twice before the consumer fetches, the older
+ * frame is overwritten; that is counted in dropped().
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    /** @brief Slot the producer writes into (producer thread only) */
+    T& writeSlot() { return m_slots[m_write]; }
+
+    /**
+     * @brief Publishes the write slot and takes the spare one to write next
+     * @return true if an unread frame was overwritten
+     */
+    bool publish() {
+        const int previous = m_middle.exchange(m_write | kFresh, std::memory_order_acq_rel);
+        m_write = previous & kIndexMask;
+        m_published.fetch_add(1, std::memory_order_relaxed);
+        if (previous & kFresh) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Makes the newest published frame the read slot (consumer thread only)
+     * @return true if there was a new frame since the last fetch
+     */
+    bool fetch() {
+        if (!(m_middle.load(std::memory_order_relaxed) & kFresh)) return false;
+        const int previous = m_middle.exchange(m_read, std::memory_order_acq_rel);
+        m_read = previous & kIndexMask;
+        return true;
+    }
+
+    /** @brief Slot the consumer reads from (consumer thread only) */
+    T& readSlot() { return m_slots[m_read]; }
+
+    /** @brief Frames published since construction or reset() */
+    uint64_t published() const { return m_published.load(std::memory_order_relaxed); }
+
+    /** @brief Frames overwritten before the consumer fetched them */
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /** @brief Clears all slots. Only safe while neither side is running. */
+    void reset() {
+        for (T& slot : m_slots) slot = T();
+        m_write = 0;
+        m_read = 1;
+        m_middle.store(2, std::memory_order_relaxed);
+        m_published.store(0, std::memory_order_relaxed);
+        m_dropped.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int kFresh = 0x4;
+    static constexpr int kIndexMask = 0x3;
+
+    T m_slots[3] = {};
+    int m_write = 0;                 // owned by the producer
+    int m_read = 1;                  // owned by the consumer
+    std::atomic<int> m_middle{ 2 };  // shared: slot index | kFresh
+    std::atomic<uint64_t> m_published{ 0 };
+    std::atomic<uint64_t> m_dropped{ 0 };
+};
+
+#endif // TRIPLEBUFFER_H
@@ -1,23 +1,31 @@
 #include "VLCPlayerHandler.h"
+#include "YuvConverter.h"
+#include "VideoFrameBuffer.h"
+#include "VlcInstance.h"
 #include <QCoreApplication>
 #include <QDir>
 #include <QSettings>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QRegularExpression>
+#include <QFileInfo>
 #include <QUrl>
 #include <QUrlQuery>
 #include <QDebug>
 #include <QQuickWindow>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QJsonObject>
-#include <QJsonDocument>
 #include <QNetworkRequest>
 #include <QVideoFrame>
 #include <QVideoFrameFormat>
-#include <QMutexLocker>
+#include <rhi/qrhi.h>
 #include <QElapsedTimer>
-#include <QThread>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
 #ifdef Q_OS_WIN
 #include <windows.h>
 #else
@@ -26,22 +34,29 @@
 #include <QDBusReply>
 #endif
 
-/**
- * @brief Callback function for VLC logging system
- * @param data User data pointer passed to the callback
- * @param level Severity level of the log message
- * @param ctx VLC log context
- * @param fmt Format string for the log message
- * @param args Variable argument list containing log message parameters
- */
-void vlcLogCallback(void* data, int level, const libvlc_log_t* ctx, const char* fmt, va_list args) {
-    // libVLC levels: 0=DEBUG, 2=NOTICE, 3=WARNING, 4=ERROR.
-    // Skip everything below WARNING so our [GHOST] lines aren't lost in noise.
-    if (level < 3) return;
-    char buf[1024];
-    vsnprintf(buf, sizeof(buf), fmt, args);
-    fprintf(stderr, "[VLC log level=%d] %s\n", level, buf);
-    fflush(stderr);
+// Player events handled in handlePlayerEvent() / playerEventCallback().
+static const libvlc_event_type_t kPlayerEvents[] = {
+    libvlc_MediaPlayerPlaying,
+    libvlc_MediaPlayerPaused,
+    libvlc_MediaPlayerEncounteredError,
+    libvlc_MediaPlayerBuffering,
+    libvlc_MediaPlayerTimeChanged,
+    libvlc_MediaPlayerLengthChanged,
+    libvlc_MediaPlayerEndReached,
+    libvlc_MediaPlayerESAdded,
+    libvlc_MediaPlayerESDeleted,
+    libvlc_MediaPlayerESSelected,
+};
+
+// Asks VLC for a seek. libVLC 4 can stop at the nearest keyframe; 3.x
+// always seeks exactly, there the merging in requestSeek() is what helps.
+static void seekPlayer(libvlc_media_player_t* player, qint64 time, bool fast) {
+#if LIBVLC_VERSION_INT >= LIBVLC_VERSION(4, 0, 0, 0)
+    libvlc_media_player_set_time(player, time, fast);
+#else
+    Q_UNUSED(fast);
+    libvlc_media_player_set_time(player, time);
+#endif
 }
 
 /**
@@ -49,62 +64,51 @@ void vlcLogCallback(void* data, int level, const libvlc_log_t* ctx, const char*
  * @param parent Parent QObject for memory management
  */
 VLCPlayerHandler::VLCPlayerHandler(QObject* parent)
+    : VLCPlayerHandler(Mode::Normal, parent)
+{
+}
+
+/**
+ * @brief Constructs the VLCPlayerHandler in the given mode
+ * @param mode Headless skips conf.ini, the stream proxy and progress sync
+ * @param parent Parent QObject for memory management
+ */
+VLCPlayerHandler::VLCPlayerHandler(Mode mode, QObject* parent)
     : QObject(parent)
     , m_vlcInstance(nullptr)
     , m_mediaPlayer(nullptr)
     , m_media(nullptr)
     , m_isPlaying(false)
     , m_videoSink(nullptr)
+    , m_pendingSubtitles(0)
     , last_percentage_watched(0.0)
     , fullScreen(false)
     , m_videoWidth(0)
     , m_videoHeight(0)
-    , m_planeY(nullptr)
-    , m_planeU(nullptr)
-    , m_planeV(nullptr)
+    , m_bitDepth(8)
+    , m_colorMatrix(YuvConverter::ColorMatrix::Bt601)
+    , m_colorRange(YuvConverter::ColorRange::Limited)
     , m_pitchY(0)
     , m_pitchU(0)
     , m_pitchV(0)
     , m_linesY(0)
     , m_linesU(0)
     , m_linesV(0)
-    , m_frameDeliveryPending(false)
+    , m_bufferPool(std::make_shared<FrameBufferPool>())
+    , m_toneMap(YuvConverter::ToneMap::None)
 {
-    // Initialize configuration from settings file
-#ifdef PROJECT_ROOT_DIR
-    QString configPath = QString(PROJECT_ROOT_DIR) + "/conf.ini";
-#else
-    QString configPath = QCoreApplication::applicationDirPath() + "/conf.ini";
-#endif
-    QSettings settings(configPath, QSettings::IniFormat);
-    m_token = settings.value("token").toString();
-    m_profileId = settings.value("selectedProfileID").toString();
-    QString port = settings.value("port").toString();
-    bool isLocalhost = settings.value("localhost", "false").toBool();
-    QString host = isLocalhost ? "localhost" : settings.value("domain").toString();
-    QString scheme = isLocalhost ? "http" : "https";
-    m_url = scheme + "://" + host + ":" + port;
-
-    fprintf(stderr, "[GHOST] VLCPlayerHandler constructor\n");
-    fprintf(stderr, "[GHOST] conf.ini path resolved to: %s\n", QFileInfo(configPath).absoluteFilePath().toUtf8().constData());
-    fprintf(stderr, "[GHOST] m_url = %s\n", m_url.toUtf8().constData());
-    fprintf(stderr, "[GHOST] token present: %s\n", m_token.isEmpty() ? "NO" : "YES");
-    fflush(stderr);
+    m_headless = mode == Mode::Headless;
+    if (m_headless) {
+        fprintf(stderr, "[GHOST] VLCPlayerHandler constructor (headless: defaults, no proxy or progress sync)\n");
+        fflush(stderr);
+    } else {
+        loadSettings();
+    }
 
-    // VLC command line arguments
-    const char* args[] = {
-        "--quiet",
-    };
-
-    // Initialize VLC instance
-    fprintf(stderr, "[GHOST] Calling libvlc_new...\n"); fflush(stderr);
-    m_vlcInstance = libvlc_new(sizeof(args) / sizeof(*args), args);
-    fprintf(stderr, "[GHOST] libvlc_new returned: %p\n", (void*)m_vlcInstance); fflush(stderr);
-    if (!m_vlcInstance) {
-        fprintf(stderr, "[GHOST] ERROR: Failed to create VLC instance\n"); fflush(stderr);
+    // Shared by every player; normally already warmed up by main().
+    m_vlcInstance = VlcInstance::acquire();
+    if (!m_vlcInstance)
         return;
-    }
-    libvlc_set_log_verbosity(m_vlcInstance, 2);
 
     // Create media player instance
     fprintf(stderr, "[GHOST] Calling libvlc_media_player_new...\n"); fflush(stderr);
@@ -117,29 +121,96 @@ VLCPlayerHandler::VLCPlayerHandler(QObject* parent)
         return;
     }
 
-    // Route decoded frames into our QVideoSink instead of a native window.
-    // Must be set before play; safe to set once for the player's lifetime.
-    libvlc_video_set_format_callbacks(m_mediaPlayer,
-                                      &VLCPlayerHandler::videoFormatCallback,
-                                      &VLCPlayerHandler::videoFormatCleanupCallback);
-    libvlc_video_set_callbacks(m_mediaPlayer,
-                               &VLCPlayerHandler::videoLockCallback,
-                               &VLCPlayerHandler::videoUnlockCallback,
-                               &VLCPlayerHandler::videoDisplayCallback,
-                               this);
+    installVideoCallbacks(m_mediaPlayer);
+
+    // Frames are handed to the sink when the video window is about to sync.
+    connect(&m_framePacer, &FramePacer::frameDue, this, &VLCPlayerHandler::deliverFrame);
+    connect(&m_thumbnails, &ThumbnailExtractor::thumbnailsChanged, this, &VLCPlayerHandler::thumbnailsChanged);
+
+    // Spaces position updates to QML by one display refresh; idle unless
+    // VLC is reporting time changes.
+    m_positionThrottle = new QTimer(this);
+    m_positionThrottle->setSingleShot(true);
+    m_positionThrottle->setTimerType(Qt::PreciseTimer);
+    connect(m_positionThrottle, &QTimer::timeout, this, &VLCPlayerHandler::publishTime);
 
-    // Initialize position update timer
-    m_positionTimer = new QTimer(this);
-    connect(m_positionTimer, &QTimer::timeout, this, &VLCPlayerHandler::updateMediaInfo);
-    m_positionTimer->setInterval(100);
+    // Seek requests arriving closer together than this are merged.
+    m_seekTimer = new QTimer(this);
+    m_seekTimer->setSingleShot(true);
+    m_seekTimer->setInterval(200);
+    connect(m_seekTimer, &QTimer::timeout, this, &VLCPlayerHandler::applySeek);
 
     // Initialize metadata update timer
     m_metadataTimer = new QTimer(this);
     connect(m_metadataTimer, &QTimer::timeout, this, &VLCPlayerHandler::updateMediaMetadataOnServer);
     m_metadataTimer->setInterval(30000);
 
-    // Set up VLC logging
-    libvlc_log_set(m_vlcInstance, vlcLogCallback, nullptr);
+    // Bounds how long playMedia() waits for VLC without a Playing or
+    // Buffering event; each buffering report restarts it.
+    m_startTimeoutTimer = new QTimer(this);
+    m_startTimeoutTimer->setSingleShot(true);
+    m_startTimeoutTimer->setInterval(5000);
+    connect(m_startTimeoutTimer, &QTimer::timeout, this, &VLCPlayerHandler::onStartTimeout);
+
+    attachPlayerEvents(m_mediaPlayer);
+
+    // Frame pipeline statistics: the counters are always on, this only
+    // turns them into percentiles for QML and the log.
+    m_statsTimer = new QTimer(this);
+    connect(m_statsTimer, &QTimer::timeout, this, &VLCPlayerHandler::sampleFrameStats);
+    m_statsTimer->setInterval(1000);
+    m_statsClock.start();
+    m_statsTimer->start();
+}
+
+/**
+ * @brief Reads conf.ini: server, stream cache, tone mapping and languages
+ *
+ * Also hands the server to the progress journal, which opens the journal
+ * and sends whatever an earlier session left pending.
+ */
+void VLCPlayerHandler::loadSettings() {
+    // Initialize configuration from settings file
+#ifdef PROJECT_ROOT_DIR
+    QString configPath = QString(PROJECT_ROOT_DIR) + "/conf.ini";
+#else
+    QString configPath = QCoreApplication::applicationDirPath() + "/conf.ini";
+#endif
+    QSettings settings(configPath, QSettings::IniFormat);
+    m_token = settings.value("token").toString();
+    m_profileId = settings.value("selectedProfileID").toString();
+    QString port = settings.value("port").toString();
+    bool isLocalhost = settings.value("localhost", "false").toBool();
+    QString host = isLocalhost ? "localhost" : settings.value("domain").toString();
+    QString scheme = isLocalhost ? "http" : "https";
+    m_url = scheme + "://" + host + ":" + port;
+    m_progressJournal.setServer(m_url, m_token, &m_networkManager);
+    const qint64 streamCacheMB = settings.value("streamCacheMB", 4096).toLongLong();
+    if (streamCacheMB > 0) {
+        // VLC only sees the loopback and the cache then; the proxy's own
+        // requests are what say something about the link.
+        connect(&m_streamProxy, &StreamProxy::upstreamSample, this, [this](qint64 connectMs, double kbps) {
+            m_cachingPolicy.recordConnect(connectMs);
+            m_cachingPolicy.recordThroughput(kbps);
+        });
+        m_streamProxy.start(m_url, m_token,
+                            QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/stream",
+                            streamCacheMB * 1024 * 1024);
+    }
+    m_toneMap = YuvConverter::toneMapFromString(
+        settings.value("hdrToneMapping", "off").toString().toUtf8().constData());
+    for (const QString& language : settings.value("subtitleLanguages", "es,en").toString().split(',', Qt::SkipEmptyParts)) {
+        if (!language.trimmed().isEmpty())
+            m_subtitleLanguages.append(language.trimmed());
+    }
+    m_cachingPolicy.load(configPath);
+
+    fprintf(stderr, "[GHOST] VLCPlayerHandler constructor\n");
+    fprintf(stderr, "[GHOST] conf.ini path resolved to: %s\n", QFileInfo(configPath).absoluteFilePath().toUtf8().constData());
+    fprintf(stderr, "[GHOST] m_url = %s\n", m_url.toUtf8().constData());
+    fprintf(stderr, "[GHOST] token present: %s\n", m_token.isEmpty() ? "NO" : "YES");
+    fprintf(stderr, "[GHOST] 10-bit tone mapping: %s\n", YuvConverter::toneMapName(m_toneMap));
+    fflush(stderr);
 }
 
 /**
@@ -147,6 +218,8 @@ VLCPlayerHandler::VLCPlayerHandler(QObject* parent)
  */
 VLCPlayerHandler::~VLCPlayerHandler() {
     uninhibitIdle();
+    finishSession("close");
+    m_cachingPolicy.finishSession();
     cleanupVLC();
 }
 
@@ -222,17 +295,36 @@ bool VLCPlayerHandler::verifyVLCSetup() {
  * @param position Desired position in milliseconds
  */
 void VLCPlayerHandler::setPosition(qint64 position) {
-    if (!m_mediaPlayer) return;
+    requestSeek(position, false);
+}
 
-    // Calculate position percentage for DASH streaming
-    libvlc_time_t duration = libvlc_media_player_get_length(m_mediaPlayer);
-    float percentage = static_cast<float>(position) / duration;
+void VLCPlayerHandler::scrubTo(qint64 position) {
+    requestSeek(position, true);
+}
 
-    libvlc_media_player_set_position(m_mediaPlayer, percentage);
+void VLCPlayerHandler::requestSeek(qint64 target, bool fast) {
+    if (!m_mediaPlayer) return;
+    if (m_length > 0)
+        target = std::min(target, m_length);
+    target = std::max<qint64>(0, target);
+
+    // One exact request in a burst makes the merged seek exact.
+    m_seekFast = m_seekTimer->isActive() ? m_seekFast && fast : fast;
+    m_seekTarget = target;
+    setTime(target);
+    m_seekTimer->start();
+}
 
-    qDebug() << "Seeking to position:" << position
-        << "Duration:" << duration
-        << "Percentage:" << percentage;
+void VLCPlayerHandler::applySeek() {
+    if (!m_mediaPlayer || m_seekTarget < 0) return;
+    qDebug() << "Seeking to position:" << m_seekTarget << (m_seekFast ? "(keyframe)" : "(exact)");
+    m_seekPending = true;
+    m_seekClock.start();
+    m_sessionLog.recordSeekStart();
+    seekPlayer(m_mediaPlayer, m_seekTarget, m_seekFast);
+    // Scrubbing previews aren't a choice worth syncing; the exact seek is.
+    if (!m_seekFast)
+        recordProgress("seek", true);
 }
 
 /**
@@ -241,44 +333,240 @@ void VLCPlayerHandler::setPosition(qint64 position) {
  */
 void VLCPlayerHandler::playMedia(float percentage_watched = 0) {
     if (m_mediaPlayer) {
+        // Resuming after pauseMedia(): the start is long done, so no start
+        // timeout, and a stall from here on counts as one. A pre-roll that
+        // loadMedia() just switched to is paused too but still starting.
+        if (!m_starting && !m_tracksPending
+            && libvlc_media_player_get_state(m_mediaPlayer) == libvlc_Paused) {
+            libvlc_media_player_set_pause(m_mediaPlayer, 0);
+            m_isPlaying = true;
+            inhibitIdle();
+            emit playingStateChanged(true);
+            return;
+        }
+
+        // Returns straight away: the GUI keeps animating while the stream
+        // opens, and handlePlayerEvent() finishes the start when VLC reports
+        // Playing (or Paused). An error during open is reported by
+        // EncounteredError, a stall by the timeout.
+        m_starting = true;
+        m_resumePosition = percentage_watched;
+        // Played again after stop() or the end: a new session from here.
+        if (!m_sessionLog.isActive() && !m_currentMediaId.isEmpty())
+            m_sessionLog.begin(m_currentMediaId);
+        if (libvlc_media_player_get_state(m_mediaPlayer) == libvlc_Playing) {
+            // Already playing: no Playing event will follow.
+            finishPlaybackStart(true);
+            return;
+        }
+        m_startTimeoutTimer->start();
         libvlc_media_player_play(m_mediaPlayer);
+    }
+}
 
-        // Wait for player to reach Playing/Paused, but bound it. Without the
-        // timeout an error during open (bad URL, decoder crash) would pin a
-        // CPU core and freeze the GUI forever. Yields between polls instead
-        // of spinning.
-        QElapsedTimer waitTimer;
-        waitTimer.start();
-        constexpr qint64 kStartTimeoutMs = 5000;
-        libvlc_state_t state = libvlc_media_player_get_state(m_mediaPlayer);
-        while (state != libvlc_Playing && state != libvlc_Paused) {
-            if (state == libvlc_Error) {
-                emit errorOccurred("VLC entered error state while starting playback");
-                return;
-            }
-            if (waitTimer.elapsed() > kStartTimeoutMs) {
-                emit errorOccurred("Timed out waiting for VLC to start playback");
-                return;
-            }
-            QThread::msleep(10);
-            state = libvlc_media_player_get_state(m_mediaPlayer);
+void VLCPlayerHandler::playerEventCallback(const libvlc_event_t* event, void* opaque) {
+    auto* self = static_cast<VLCPlayerHandler*>(opaque);
+    const int type = event->type;
+
+    if (type == libvlc_MediaPlayerTimeChanged) {
+        // Fires many times a second: keep only the newest value and queue
+        // at most one pickup.
+        self->m_pendingTime.store(event->u.media_player_time_changed.new_time, std::memory_order_relaxed);
+        if (!self->m_timeUpdatePending.exchange(true, std::memory_order_acq_rel))
+            QMetaObject::invokeMethod(self, "publishTime", Qt::QueuedConnection);
+        return;
+    }
+    if (type == libvlc_MediaPlayerESAdded || type == libvlc_MediaPlayerESDeleted
+        || type == libvlc_MediaPlayerESSelected) {
+        const int esType = event->u.media_player_es_changed.i_type;
+        QMetaObject::invokeMethod(self, [self, esType]() {
+            self->handleTrackEvent(esType);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    double value = 0.0;
+    if (type == libvlc_MediaPlayerBuffering)
+        value = event->u.media_player_buffering.new_cache;
+    else if (type == libvlc_MediaPlayerLengthChanged)
+        value = static_cast<double>(event->u.media_player_length_changed.new_length);
+    // VLC must not be called back into from its event thread; queue to the
+    // GUI thread. Dropped if the handler is destroyed first.
+    QMetaObject::invokeMethod(self, [self, type, value]() {
+        self->handlePlayerEvent(type, value);
+    }, Qt::QueuedConnection);
+}
+
+void VLCPlayerHandler::publishTime() {
+    // A pickup during the throttle interval is left to its timeout.
+    if (m_positionThrottle->isActive())
+        return;
+    if (!m_timeUpdatePending.exchange(false, std::memory_order_acq_rel))
+        return;
+    const qint64 time = m_pendingTime.load(std::memory_order_relaxed);
+    if (m_seekTarget >= 0) {
+        // Times from before the seek took effect would drag the position
+        // back. A keyframe seek may land several seconds off the target.
+        constexpr qint64 kSeekToleranceMs = 10000;
+        if (m_seekTimer->isActive())
+            return;
+        const bool reached = std::abs(time - m_seekTarget) <= kSeekToleranceMs;
+        if (!reached && m_seekClock.elapsed() < 1000)
+            return;
+        if (reached)
+            m_sessionLog.recordSeekSettled();
+        m_seekTarget = -1;
+    }
+    setTime(time);
+    updatePreroll();
+
+    QScreen* screen = m_videoOutput && m_videoOutput->window() ? m_videoOutput->window()->screen()
+                                                               : QGuiApplication::primaryScreen();
+    const qreal refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60.0;
+    m_positionThrottle->start(std::max(1, qRound(1000.0 / refreshRate)));
+}
+
+void VLCPlayerHandler::setTime(qint64 time) {
+    if (time == m_time)
+        return;
+    m_time = time;
+    emit positionChanged(m_time);
+}
+
+void VLCPlayerHandler::handlePlayerEvent(int type, double value) {
+    const float buffering = static_cast<float>(value);
+    switch (type) {
+    case libvlc_MediaPlayerPlaying:
+        if (m_starting) {
+            finishPlaybackStart(true);
+        } else if (!m_isPlaying) {
+            // Resumed by VLC itself, e.g. after a network stall.
+            m_isPlaying = true;
+            inhibitIdle();
+            emit playingStateChanged(true);
+        }
+        break;
+    case libvlc_MediaPlayerPaused:
+        if (m_starting)
+            finishPlaybackStart(false);
+        break;
+    case libvlc_MediaPlayerEncounteredError:
+        m_sessionLog.recordError();
+        m_startTimeoutTimer->stop();
+        emit errorOccurred(m_starting ? "VLC entered error state while starting playback"
+                                      : "VLC encountered an error during playback");
+        m_starting = false;
+        break;
+    case libvlc_MediaPlayerBuffering:
+        // Still making progress, so don't time out yet.
+        if (m_starting)
+            m_startTimeoutTimer->start();
+        if (m_starting && m_openClock.isValid() && m_connectMs < 0 && buffering > 0.0f)
+            m_connectMs = m_openClock.elapsed();
+        if (buffering >= 100.0f) {
+            m_seekPending = false;
+            setStalled(false);
+        } else if (!m_starting && m_isPlaying && !m_seekPending) {
+            setStalled(true);
+        }
+        if (qRound(buffering) != qRound(m_bufferingProgress)) {
+            m_bufferingProgress = buffering;
+            emit bufferingProgressChanged(m_bufferingProgress);
+        }
+        break;
+    case libvlc_MediaPlayerLengthChanged:
+        if (static_cast<qint64>(value) != m_length) {
+            m_length = static_cast<qint64>(value);
+            emit durationChanged(m_length);
         }
+        break;
+    case libvlc_MediaPlayerEndReached:
+        m_isPlaying = false;
+        uninhibitIdle();
+        emit playingStateChanged(false);
+        recordProgress("end", true);
+        finishSession("end");
+        emit mediaEnded();
+        break;
+    default:
+        break;
+    }
+}
 
-        m_isPlaying = true;
+void VLCPlayerHandler::handleTrackEvent(int esType) {
+    // Demuxers keep finding tracks after the start, and subtitle slaves
+    // arrive whenever their download finishes: every change rebuilds the
+    // list of its kind, which also applies a stored choice the moment its
+    // track exists.
+    if (esType == libvlc_track_audio)
+        loadAudioTracks(m_pendingAudioChoice);
+    else if (esType == libvlc_track_text)
+        loadSubtitleTracks(m_pendingSubtitlesChoice);
+}
 
-        // Set initial position if specified
-        if (percentage_watched > 0.0) {
-            libvlc_media_player_set_position(m_mediaPlayer, percentage_watched);
-            libvlc_time_t currentTime = libvlc_media_player_get_time(m_mediaPlayer);
-            emit positionChanged(currentTime);
+void VLCPlayerHandler::finishPlaybackStart(bool playing) {
+    m_starting = false;
+    m_startTimeoutTimer->stop();
+    m_sessionLog.recordPlaying();
+
+    if (m_openClock.isValid()) {
+        // Filling the cache reads as fast as the link allows, so the bytes
+        // read since the first data arrived give the throughput.
+        m_startupMs = m_openClock.elapsed();
+        libvlc_media_stats_t stats;
+        // Through the proxy this timed the loopback, or just the cache; the
+        // proxy reports its upstream requests instead.
+        if (m_connectMs >= 0 && !m_streamProxy.isRunning()) {
+            m_cachingPolicy.recordConnect(m_connectMs);
+            const qint64 fillMs = m_startupMs - m_connectMs;
+            if (fillMs >= 50 && m_media && libvlc_media_get_stats(m_media, &stats)) {
+                m_cachingPolicy.recordThroughput(stats.i_read_bytes * 8.0 / fillMs);
+            }
         }
+        fprintf(stderr, "[GHOST] playback started after %lld ms (first data after %lld ms)\n",
+                static_cast<long long>(m_startupMs), static_cast<long long>(m_connectMs));
+        fflush(stderr);
+        m_openClock.invalidate();
+    }
 
-        // Start timers and notify state change
-        m_positionTimer->start();
-        m_metadataTimer->start();
-        inhibitIdle();
-        emit playingStateChanged(true);
+    // Set initial position if specified
+    if (m_resumePosition > 0.0f) {
+        m_seekPending = true;
+        libvlc_media_player_set_position(m_mediaPlayer, m_resumePosition);
+        m_resumePosition = 0.0f;
+    }
+
+    // Duration is only known once the input is running. The track lists
+    // follow ES events; this catches a pre-rolled player whose tracks
+    // appeared before it was ours.
+    if (m_tracksPending) {
+        m_tracksPending = false;
+        loadSubtitleTracks(m_pendingSubtitlesChoice);
+        loadAudioTracks(m_pendingAudioChoice);
+        emit mediaLoaded();
+        m_length = libvlc_media_player_get_length(m_mediaPlayer);
+        emit durationChanged(m_length);
+
+        // Previews wait until the start no longer needs the whole link.
+        QTimer::singleShot(15000, this, [this, mediaId = m_currentMediaId]() {
+            if (mediaId == m_currentMediaId && m_length > 0 && !m_audioOnly)
+                startThumbnails();
+        });
     }
+
+    // Start timers and notify state change
+    m_isPlaying = playing;
+    m_metadataTimer->start();
+    if (playing)
+        inhibitIdle();
+    emit playingStateChanged(playing);
+}
+
+void VLCPlayerHandler::onStartTimeout() {
+    if (!m_starting)
+        return;
+    m_starting = false;
+    emit errorOccurred("Timed out waiting for VLC to start playback");
 }
 
 /**
@@ -288,10 +576,11 @@ void VLCPlayerHandler::pauseMedia() {
     if (m_mediaPlayer) {
         libvlc_media_player_pause(m_mediaPlayer);
         m_isPlaying = false;
-        m_positionTimer->stop();
         uninhibitIdle();
         emit playingStateChanged(false);
-        emit positionChanged(libvlc_media_player_get_time(m_mediaPlayer));
+        if (m_seekTarget < 0)
+            setTime(libvlc_media_player_get_time(m_mediaPlayer));
+        recordProgress("pause", true);
     }
 }
 
@@ -300,12 +589,19 @@ void VLCPlayerHandler::pauseMedia() {
  */
 void VLCPlayerHandler::stop() {
     if (m_mediaPlayer) {
+        // Before the position is reset below.
+        if (libvlc_media_player_get_state(m_mediaPlayer) != libvlc_Stopped)
+            recordProgress("stop", true);
+        finishSession("stop");
+        cancelPreroll();
+        m_thumbnails.stop();
+        m_seekTimer->stop();
+        m_seekTarget = -1;
         libvlc_media_player_stop(m_mediaPlayer);
         m_isPlaying = false;
-        m_positionTimer->stop();
         uninhibitIdle();
         emit playingStateChanged(false);
-        emit positionChanged(0);
+        setTime(0);
     }
 }
 
@@ -313,102 +609,64 @@ void VLCPlayerHandler::stop() {
  * @brief Advances playback position by 30 seconds
  */
 void VLCPlayerHandler::forward30sec() {
-    if (m_mediaPlayer) {
-        libvlc_time_t current_time = libvlc_media_player_get_time(m_mediaPlayer);
-        libvlc_time_t new_time = current_time + 30000;
-        libvlc_media_player_set_time(m_mediaPlayer, new_time);
-        emit positionChanged(libvlc_media_player_get_time(m_mediaPlayer));
-    }
+    // Relative to the displayed position, so repeated presses add up.
+    requestSeek(m_time + 30000, false);
 }
 
 /**
  * @brief Rewinds playback position by 30 seconds
  */
 void VLCPlayerHandler::back30sec() {
-    if (m_mediaPlayer) {
-        libvlc_time_t current_time = libvlc_media_player_get_time(m_mediaPlayer);
-        libvlc_time_t new_time = current_time - 30000;
-        libvlc_media_player_set_time(m_mediaPlayer, new_time);
-        emit positionChanged(libvlc_media_player_get_time(m_mediaPlayer));
-    }
-}
-
-/**
- * @brief Updates media playback information and emits signals
- */
-void VLCPlayerHandler::updateMediaInfo() {
-    if (!m_mediaPlayer) return;
-
-    libvlc_state_t state = libvlc_media_player_get_state(m_mediaPlayer);
-    if (state == libvlc_Playing || state == libvlc_Paused) {
-        libvlc_time_t currentTime = libvlc_media_player_get_time(m_mediaPlayer);
-        libvlc_time_t duration = libvlc_media_player_get_length(m_mediaPlayer);
-        float position = libvlc_media_player_get_position(m_mediaPlayer);
-
-        if (currentTime >= 0 && duration > 0) {
-            emit positionChanged(currentTime);
-        }
-    }
-    else if (state == libvlc_Ended) {
-        updateMediaMetadataOnServer();
-        emit mediaEnded();
-    }
+    requestSeek(m_time - 30000, false);
 }
 
 /**
  * @brief Triggers an immediate metadata update
  */
 void VLCPlayerHandler::updateMediaMetadata() {
-    updateMediaMetadataOnServer();
+    // Called on the way out of the player: try to deliver right away; the
+    // journal keeps it for next time if this doesn't get through.
+    recordProgress("close", true);
+    m_progressJournal.flush();
 }
 
 /**
  * @brief Sends current media playback metadata to the server
  */
 void VLCPlayerHandler::updateMediaMetadataOnServer() {
-    if (!m_mediaPlayer) return;
+    recordProgress("periodic", false);
+}
 
-    // Prepare network request
-    QUrl url(m_url + "/update_media_metadata");
-    QNetworkRequest request(url);
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-    request.setRawHeader("Authorization", "Bearer " + m_token.toUtf8());
+void VLCPlayerHandler::recordProgress(const QString& event, bool urgent) {
+    if (m_headless || !m_mediaPlayer || m_currentMediaId.isEmpty()) return;
 
     // Create metadata payload
     QJsonObject jsonPayload;
     jsonPayload["profileID"] = m_profileId;
     jsonPayload["mediaID"] = m_currentMediaId;
 
-    // Calculate position based on playback state
+    // Calculate position based on playback state. m_time already holds the
+    // target of a seek VLC hasn't finished.
     libvlc_state_t state = libvlc_media_player_get_state(m_mediaPlayer);
-    float position = (state != libvlc_Ended) ?
-        libvlc_media_player_get_position(m_mediaPlayer) : 1.0;
+    float position = state == libvlc_Ended ? 1.0f
+        : m_length > 0 ? static_cast<float>(m_time) / m_length
+        : libvlc_media_player_get_position(m_mediaPlayer);
 
     jsonPayload["percentageWatched"] = QString::number(position, 'f', 3);
     jsonPayload["languageChosen"] = m_currentAudioText;
     jsonPayload["subtitlesChosen"] = m_currentSubtitlesText;
 
-    // Send update request
-    QJsonDocument doc(jsonPayload);
-    QByteArray jsonData = doc.toJson();
-    QNetworkReply* reply = m_networkManager.post(request, jsonData);
-
-    // Handle response
-    connect(reply, &QNetworkReply::finished, this, [reply]() {
-        if (reply->error() == QNetworkReply::NoError) {
-            qDebug() << "Successfully updated media metadata";
-        }
-        else {
-            qDebug() << "Error updating media metadata:" << reply->errorString();
-        }
-        reply->deleteLater();
-        });
+    m_progressJournal.record(jsonPayload, event, urgent);
 }
 
 /**
  * @brief Cleans up VLC resources
  */
 void VLCPlayerHandler::cleanupVLC() {
+    cancelPreroll();
+    if (m_mediaPlayer) {
+        detachPlayerEvents(m_mediaPlayer);
+    }
     if (m_media) {
         libvlc_media_release(m_media);
         m_media = nullptr;
@@ -418,15 +676,15 @@ void VLCPlayerHandler::cleanupVLC() {
         m_mediaPlayer = nullptr;
     }
     if (m_vlcInstance) {
+        // Only our reference; the instance stays loaded for the next player.
         libvlc_release(m_vlcInstance);
         m_vlcInstance = nullptr;
     }
-    // VLC's format-cleanup callback normally frees these, but free defensively
-    // in case the player is destroyed without ever decoding a frame.
-    std::free(m_planeY);
-    std::free(m_planeU);
-    std::free(m_planeV);
-    m_planeY = m_planeU = m_planeV = nullptr;
+    // VLC's format-cleanup callback normally drops these, but release
+    // defensively in case the player is destroyed without ever decoding a
+    // frame. Pictures still shown by the sink stay alive until it lets go.
+    m_frames.reset();
+    m_pictures.clear();
 }
 
 /**
@@ -434,7 +692,7 @@ void VLCPlayerHandler::cleanupVLC() {
  * @return qint64 Duration in milliseconds
  */
 qint64 VLCPlayerHandler::duration() const {
-    return m_mediaPlayer ? (qint64)libvlc_media_player_get_length(m_mediaPlayer) : 0;
+    return m_length;
 }
 
 /**
@@ -442,7 +700,7 @@ qint64 VLCPlayerHandler::duration() const {
  * @return qint64 Position in milliseconds
  */
 qint64 VLCPlayerHandler::position() const {
-    return m_mediaPlayer ? (qint64)libvlc_media_player_get_time(m_mediaPlayer) : 0;
+    return m_time;
 }
 
 /**
@@ -458,6 +716,7 @@ bool VLCPlayerHandler::isPlaying() const {
  * @param volume Volume level (0-100)
  */
 void VLCPlayerHandler::setVolume(int volume) {
+    m_volume = volume;
     libvlc_audio_set_volume(m_mediaPlayer, volume);
 }
 
@@ -482,6 +741,103 @@ void VLCPlayerHandler::setVideoSink(QVideoSink* sink) {
     emit videoSinkChanged();
 }
 
+QQuickItem* VLCPlayerHandler::videoOutput() const {
+    return m_videoOutput;
+}
+
+/**
+ * @brief Sets the item the video is displayed in.
+ *
+ * Its size is tracked so frames shown smaller than they were decoded are
+ * scaled down during conversion instead of after upload.
+ */
+void VLCPlayerHandler::setVideoOutput(QQuickItem* item) {
+    if (m_videoOutput == item)
+        return;
+    if (m_videoOutput)
+        disconnect(m_videoOutput, nullptr, this, nullptr);
+    m_videoOutput = item;
+    if (item) {
+        connect(item, &QQuickItem::widthChanged, this, &VLCPlayerHandler::updateOutputSize);
+        connect(item, &QQuickItem::heightChanged, this, &VLCPlayerHandler::updateOutputSize);
+        connect(item, &QQuickItem::windowChanged, this, &VLCPlayerHandler::updateOutputSize);
+        connect(item, &QQuickItem::windowChanged, this, [this](QQuickWindow* window) {
+            m_framePacer.setWindow(window);
+        });
+    }
+    m_framePacer.setWindow(item ? item->window() : nullptr);
+    updateOutputSize();
+    emit videoOutputChanged();
+}
+
+void VLCPlayerHandler::updateOutputSize() {
+    QQuickWindow* window = m_videoOutput ? m_videoOutput->window() : nullptr;
+    if (!window) {
+        m_outputSize = QSize();
+        return;
+    }
+    const qreal ratio = window->effectiveDevicePixelRatio();
+    m_outputSize = QSize(qRound(m_videoOutput->width() * ratio),
+                         qRound(m_videoOutput->height() * ratio));
+}
+
+QSize VLCPlayerHandler::deliverySize(int width, int height) const {
+    // Milder reductions cost more to resample than converting and uploading
+    // the extra pixels does, so they keep the full picture.
+    constexpr double kMaxScale = 0.75;
+    const QSize full(width, height);
+    if (m_outputSize.isEmpty())
+        return full;
+    const double scale = std::min(static_cast<double>(m_outputSize.width()) / width,
+                                  static_cast<double>(m_outputSize.height()) / height);
+    if (scale > kMaxScale)
+        return full;
+    // Even dimensions keep 4:2:0 chroma exactly half the luma size.
+    const int w = std::max(2, static_cast<int>(std::lround(width * scale)) & ~1);
+    const int h = std::max(2, static_cast<int>(std::lround(height * scale)) & ~1);
+    return QSize(w, h);
+}
+
+/**
+ * @brief Switches video decoding off or back on
+ *
+ * Switching off deselects the video ES: VLC closes the decoder and the video
+ * output, so nothing reaches the callbacks and no pictures are allocated.
+ * Media opened in this mode carries :no-video and never selects one at
+ * all; showing video again then means reopening it at the same position.
+ */
+void VLCPlayerHandler::setAudioOnly(bool audioOnly) {
+    if (m_audioOnly == audioOnly)
+        return;
+    m_audioOnly = audioOnly;
+    emit audioOnlyChanged();
+    // The standby player was opened for the other mode.
+    cancelPreroll();
+    fprintf(stderr, "[GHOST] audio-only playback %s\n", audioOnly ? "on" : "off"); fflush(stderr);
+    if (!m_mediaPlayer || !m_media || m_currentMediaId.isEmpty())
+        return;
+
+    if (audioOnly) {
+        m_thumbnails.stop();
+        m_videoTrackId = libvlc_video_get_track(m_mediaPlayer);
+        if (m_videoTrackId >= 0)
+            libvlc_video_set_track(m_mediaPlayer, -1);
+        if (m_videoSink)
+            m_videoSink->setVideoFrame(QVideoFrame());
+    } else if (!m_mediaAudioOnly && m_videoTrackId >= 0) {
+        // The decoder restarts at the next keyframe.
+        libvlc_video_set_track(m_mediaPlayer, m_videoTrackId);
+        if (m_length > 0)
+            startThumbnails();
+    } else {
+        QVariantMap metadata;
+        metadata["percentage_watched"] = m_length > 0 ? static_cast<double>(m_time) / m_length : 0.0;
+        metadata["language_chosen"] = m_currentAudioText;
+        metadata["subtitles_chosen"] = m_currentSubtitlesText;
+        loadMedia(m_currentMediaId, metadata);
+    }
+}
+
 /**
  * @brief Toggles fullscreen mode by signalling the QML layer.
  *
@@ -498,12 +854,47 @@ void VLCPlayerHandler::setFullScreen(bool setFullScreen) {
 // ---------------------------------------------------------------------------
 // libVLC video callbacks
 //
-// VLC invokes these on its video output thread. We use software rendering
-// into a single BGRA32 buffer and let m_frameMutex serialise access between
-// VLC (lock/unlock) and the GUI thread (deliverFrame). Hardware decoding is
-// implicitly disabled while these callbacks are installed.
+// VLC invokes these on its video output thread and decodes straight into
+// reference-counted VideoPicture buffers. Finished pictures reach the GUI
+// thread (deliverFrame) through the lock-free m_frames triple buffer, so
+// neither side ever waits for the other. Hardware decoding is implicitly
+// disabled while these callbacks are installed.
 // ---------------------------------------------------------------------------
 
+/**
+ * @brief Returns true if the sink renders through an RHI backend that can
+ *        sample planar YUV textures.
+ *
+ * Qt's RHI video path uploads each plane as a single-channel texture and
+ * converts to RGB in a fragment shader. The software scene graph backend
+ * has no RHI, and would convert on the CPU again, so it keeps the BGRA path.
+ * 10-bit planes need 16-bit (R16) textures, which GLES 2 class GPUs lack.
+ */
+static bool sinkAcceptsPlanarYuv(QVideoSink* sink, int bitDepth) {
+    if (!sink) return false;
+    QRhi* rhi = sink->rhi();
+    if (!rhi) return false;
+    if (bitDepth > 8)
+        return rhi->isTextureFormatSupported(QRhiTexture::R16);
+    return rhi->isTextureFormatSupported(QRhiTexture::R8) ||
+           rhi->isTextureFormatSupported(QRhiTexture::RED_OR_ALPHA8);
+}
+
+/**
+ * @brief Returns true for the 10-bit 4:2:0 chromas VLC's software decoders
+ *        produce (HEVC Main 10, AV1, VP9 profile 2)
+ *
+ * VLC can hand all of them over as I0AL with at most a cheap repack, while
+ * forcing I420 would add its own 10→8-bit conversion to the vout thread.
+ */
+static bool isHighBitDepthChroma(const char* chroma) {
+    static const char* const kChromas[] = { "I0AL", "I0AB", "P010" };
+    for (const char* candidate : kChromas) {
+        if (std::memcmp(chroma, candidate, 4) == 0) return true;
+    }
+    return false;
+}
+
 unsigned VLCPlayerHandler::videoFormatCallback(void** opaque, char* chroma,
                                                unsigned* width, unsigned* height,
                                                unsigned* pitches, unsigned* lines) {
@@ -513,21 +904,45 @@ unsigned VLCPlayerHandler::videoFormatCallback(void** opaque, char* chroma,
     // most codecs, so VLC writes directly to our buffers without an internal
     // colour conversion pass — which is what was producing the green stripes
     // when we asked for RV32. Qt's video sink converts YUV→RGB on the GPU.
-    std::memcpy(chroma, "I420", 4);
+    // On entry chroma holds the decoder's format; 10-bit sources get I0AL
+    // (the same layout with 16-bit samples) for the same reason. J420 is
+    // I420 in full range (MJPEG and some phone footage); keeping it avoids a
+    // range conversion in VLC and tells us which range to decode with.
+    const int bitDepth = isHighBitDepthChroma(chroma) ? 10 : 8;
+    const int bytesPerSample = bitDepth > 8 ? 2 : 1;
+    const bool fullRange = bitDepth == 8 && std::memcmp(chroma, "J420", 4) == 0;
+    std::memcpy(chroma, bitDepth > 8 ? "I0AL" : (fullRange ? "J420" : "I420"), 4);
 
     const int w = static_cast<int>(*width);
     const int h = static_cast<int>(*height);
-    // Round Y dimensions up to multiples of 32 so VLC's pipeline can write
-    // its padded output safely. UV dimensions are half of the (aligned) Y.
-    const int alignedW = (w + 31) & ~31;
+    // Round Y dimensions up so VLC's pipeline can write its padded output
+    // safely. UV dimensions are half of the (aligned) Y. A 64-byte luma pitch
+    // keeps every row of every plane 32-byte aligned for the SIMD kernels.
+    const int alignedW = (w + 63) & ~63;
     const int alignedH = (h + 31) & ~31;
 
-    QMutexLocker lock(&self->m_frameMutex);
     self->m_videoWidth  = w;
     self->m_videoHeight = h;
-    self->m_pitchY = alignedW;
-    self->m_pitchU = alignedW / 2;
-    self->m_pitchV = alignedW / 2;
+    self->m_bitDepth = bitDepth;
+    // libVLC 3 passes no colour metadata to these callbacks, so the matrix
+    // follows resolution (and the configured HDR transfer for 10-bit).
+    const bool hdr = bitDepth > 8 && self->m_toneMap != YuvConverter::ToneMap::None;
+    self->m_colorMatrix = YuvConverter::guessColorMatrix(w, h, hdr);
+    self->m_colorRange = fullRange ? YuvConverter::ColorRange::Full : YuvConverter::ColorRange::Limited;
+    // The sink pointer is only replaced from QML before playback starts, so
+    // reading it from VLC's thread here is safe in practice.
+    const bool planar = sinkAcceptsPlanarYuv(self->m_videoSink, bitDepth);
+    self->m_planarOutput.store(planar, std::memory_order_release);
+    fprintf(stderr, "[GHOST] video format %dx%d %s %s %s, output: %s\n", w, h,
+            bitDepth > 8 ? "I0AL" : (fullRange ? "J420" : "I420"),
+            YuvConverter::colorMatrixName(self->m_colorMatrix),
+            fullRange ? "full" : "limited",
+            planar ? (bitDepth > 8 ? "YUV420P10 passthrough (zero-copy)" : "YUV420P passthrough (zero-copy)")
+                   : "CPU BGRA");
+    fflush(stderr);
+    self->m_pitchY = alignedW * bytesPerSample;
+    self->m_pitchU = alignedW / 2 * bytesPerSample;
+    self->m_pitchV = alignedW / 2 * bytesPerSample;
     self->m_linesY = alignedH;
     self->m_linesU = alignedH / 2;
     self->m_linesV = alignedH / 2;
@@ -539,107 +954,251 @@ unsigned VLCPlayerHandler::videoFormatCallback(void** opaque, char* chroma,
     lines[1]   = static_cast<unsigned>(self->m_linesU);
     lines[2]   = static_cast<unsigned>(self->m_linesV);
 
-    std::free(self->m_planeY);
-    std::free(self->m_planeU);
-    std::free(self->m_planeV);
-    self->m_planeY = static_cast<uchar*>(std::calloc(self->m_pitchY, self->m_linesY));
-    self->m_planeU = static_cast<uchar*>(std::calloc(self->m_pitchU, self->m_linesU));
-    self->m_planeV = static_cast<uchar*>(std::calloc(self->m_pitchV, self->m_linesV));
+    // Pictures of the old geometry go back to the buffer pool once the GUI
+    // and the sink let go of them; videoLockCallback takes new ones lazily,
+    // reusing pooled planes when the geometry repeats. Same-geometry
+    // pictures (the next episode of a series) are kept as they are.
+    const int newPitches[3] = { self->m_pitchY, self->m_pitchU, self->m_pitchV };
+    const int newLines[3] = { self->m_linesY, self->m_linesU, self->m_linesV };
+    if (!self->m_pictures.empty() && !self->m_pictures.front()->matches(w, h, newPitches, newLines))
+        self->m_pictures.clear();
+    self->m_frames.writeSlot().reset();
+
+    // VLC writes pitch × lines bytes into whatever videoLockCallback hands
+    // it, so running out of memory later needs planes of this size too.
+    if (!self->m_scratchPicture || !self->m_scratchPicture->matches(w, h, newPitches, newLines)) {
+        self->m_scratchPicture.reset();
+        self->m_scratchPicture = VideoPicture::create(self->m_bufferPool, w, h, newPitches, newLines, bitDepth);
+    }
+    if (!self->m_scratchPicture) {
+        fprintf(stderr, "[GHOST] ERROR: no memory for %dx%d video planes, refusing the format\n", w, h);
+        fflush(stderr);
+        return 0;
+    }
 
     return 1;
 }
 
 void VLCPlayerHandler::videoFormatCleanupCallback(void* opaque) {
     auto* self = static_cast<VLCPlayerHandler*>(opaque);
-    QMutexLocker lock(&self->m_frameMutex);
-    std::free(self->m_planeY);
-    std::free(self->m_planeU);
-    std::free(self->m_planeV);
-    self->m_planeY = self->m_planeU = self->m_planeV = nullptr;
+    fprintf(stderr, "[GHOST] video output closed: %llu frames decoded, %llu overwritten before display\n",
+            static_cast<unsigned long long>(self->m_frames.published()),
+            static_cast<unsigned long long>(self->m_frames.dropped()));
+    fprintf(stderr, "[GHOST] frame pool: %.1f MiB in use, %.1f MiB idle, high-water %.1f MiB\n",
+            self->m_bufferPool->bytesInUse() / 1048576.0,
+            self->m_bufferPool->bytesIdle() / 1048576.0,
+            self->m_bufferPool->highWaterBytes() / 1048576.0);
+    const QVariantMap pacing = self->m_framePacer.stats();
+    fprintf(stderr, "[GHOST] frame pacing: %llu presented, latency %.1f ms mean, %.1f ms jitter, %.1f ms max, %llu late (refresh %.1f ms)\n",
+            pacing["presented"].toULongLong(), pacing["meanLatencyMs"].toDouble(),
+            pacing["jitterMs"].toDouble(), pacing["maxLatencyMs"].toDouble(),
+            pacing["lateFrames"].toULongLong(), pacing["refreshIntervalMs"].toDouble());
+    fflush(stderr);
+    self->m_framePacer.reset();
+    // m_pictures stays: if the next format has the same geometry, as the
+    // next episode usually does, videoFormatCallback keeps using them.
+    // Audio-only playback won't need them again.
+    self->m_frames.writeSlot().reset();
+    self->m_scratchPicture.reset();
+    if (self->m_audioOnly) {
+        self->m_pictures.clear();
+        self->m_bufferPool->trim();
+    }
     self->m_videoWidth = 0;
     self->m_videoHeight = 0;
+    self->m_bitDepth = 8;
+    self->m_colorMatrix = YuvConverter::ColorMatrix::Bt601;
+    self->m_colorRange = YuvConverter::ColorRange::Limited;
     self->m_pitchY = self->m_pitchU = self->m_pitchV = 0;
     self->m_linesY = self->m_linesU = self->m_linesV = 0;
 }
 
+/**
+ * @brief Returns a picture nobody else references, allocating one if needed
+ *
+ * A picture is free when m_pictures holds its only reference: it is in
+ * neither the published nor the GUI's slot of m_frames, and no QVideoFrame
+ * in the sink still wraps it. Only called on VLC's video output thread.
+ */
+std::shared_ptr<VideoPicture> VLCPlayerHandler::acquirePicture() {
+    for (const auto& picture : m_pictures) {
+        // use_count() is a relaxed read and orders nothing. Holders on the
+        // GUI thread hand pictures back through m_frames, whose exchanges
+        // synchronise; Qt's frames on the render thread don't, so their
+        // release is what makes it safe to write the planes again.
+        if (picture.use_count() == 1 && picture->frameRefs.load(std::memory_order_acquire) == 0) {
+            // Kept across a format change, which may have changed these.
+            picture->matrix = m_colorMatrix;
+            picture->range = m_colorRange;
+            return picture;
+        }
+    }
+
+    const int pitches[3] = { m_pitchY, m_pitchU, m_pitchV };
+    const int lines[3] = { m_linesY, m_linesU, m_linesV };
+    auto picture = VideoPicture::create(m_bufferPool, m_videoWidth, m_videoHeight,
+                                        pitches, lines, m_bitDepth);
+    if (picture) {
+        picture->matrix = m_colorMatrix;
+        picture->range = m_colorRange;
+        m_pictures.push_back(picture);
+    }
+    return picture;
+}
+
 void* VLCPlayerHandler::videoLockCallback(void* opaque, void** planes) {
     auto* self = static_cast<VLCPlayerHandler*>(opaque);
-    self->m_frameMutex.lock();
-    planes[0] = self->m_planeY;
-    planes[1] = self->m_planeU;
-    planes[2] = self->m_planeV;
-    return nullptr;
+    const qint64 start = FramePacer::now();
+
+    // The write slot belongs to this thread alone, so no lock is needed.
+    // Drop whatever it held (it may still be on screen) and decode into a
+    // picture nothing else references.
+    std::shared_ptr<VideoPicture>& slot = self->m_frames.writeSlot();
+    slot.reset();
+    slot = self->acquirePicture();
+    VideoPicture* picture = slot.get();
+    if (!picture) {
+        // Out of memory: VLC decodes into the scratch picture sized at
+        // format time, and videoDisplayCallback drops the frame.
+        VideoPicture* scratch = self->m_scratchPicture.get();
+        planes[0] = scratch->planes[0];
+        planes[1] = scratch->planes[1];
+        planes[2] = scratch->planes[2];
+        return nullptr;
+    }
+    planes[0] = picture->planes[0];
+    planes[1] = picture->planes[1];
+    planes[2] = picture->planes[2];
+    self->m_frameStats.recordLock(FramePacer::now() - start);
+    return picture;
 }
 
-void VLCPlayerHandler::videoUnlockCallback(void* opaque, void* /*picture*/, void* const* /*planes*/) {
-    auto* self = static_cast<VLCPlayerHandler*>(opaque);
-    self->m_frameMutex.unlock();
+void VLCPlayerHandler::videoUnlockCallback(void* /*opaque*/, void* /*picture*/, void* const* /*planes*/) {
+    // Nothing to release: the picture stays in the write slot until displayed.
 }
 
-void VLCPlayerHandler::videoDisplayCallback(void* opaque, void* /*picture*/) {
+void VLCPlayerHandler::videoDisplayCallback(void* opaque, void* picture) {
     auto* self = static_cast<VLCPlayerHandler*>(opaque);
+    if (!picture) return;
 
-    // Coalesce: if a delivery is already queued, drop this one — we'll just
-    // pick up the newest frame the next time the GUI thread runs.
-    {
-        QMutexLocker lock(&self->m_frameMutex);
-        if (self->m_frameDeliveryPending) return;
-        self->m_frameDeliveryPending = true;
-    }
-    QMetaObject::invokeMethod(self, "deliverFrame", Qt::QueuedConnection);
+    // libVLC 3 doesn't pass the PTS, but the vout thread calls display at
+    // the picture's presentation date, so now is its timestamp.
+    static_cast<VideoPicture*>(picture)->presentationTime = FramePacer::now();
+
+    // Swap the finished picture into the shared slot. If the GUI never took
+    // the previous one it is overwritten and counted as dropped.
+    self->m_frames.publish();
+
+    // Delivered at the next vsync; a picture published before then simply
+    // replaces this one in the slot.
+    self->m_framePacer.requestFrame();
 }
 
 /**
- * @brief GUI-thread slot that copies the latest VLC frame into a
- *        QVideoFrame and pushes it to the bound QVideoSink.
+ * @brief GUI-thread slot that pushes the newest decoded picture into the
+ *        bound QVideoSink.
+ *
+ * Planar YUV is wrapped in a VideoFrameBuffer and handed to the sink without
+ * copying; otherwise the picture is converted to BGRA on the CPU. Pictures
+ * much larger than the video item are first scaled down to its size.
  */
 void VLCPlayerHandler::deliverFrame() {
-    QMutexLocker lock(&m_frameMutex);
-    m_frameDeliveryPending = false;
+    if (!m_frames.fetch())
+        return;
+
+    std::shared_ptr<VideoPicture> picture = m_frames.readSlot();
+    if (!m_videoSink || !picture || picture->width <= 0 || picture->height <= 0)
+        return;
+    const qint64 presentationTime = picture->presentationTime;
+    const qint64 start = FramePacer::now();
+
+    YuvConverter::I420Planes src;
+    src.y = picture->planes[0];
+    src.u = picture->planes[1];
+    src.v = picture->planes[2];
+    src.pitchY = picture->pitches[0];
+    src.pitchU = picture->pitches[1];
+    src.pitchV = picture->pitches[2];
+    src.width = picture->width;
+    src.height = picture->height;
+    src.bitDepth = picture->bitDepth;
+    src.toneMap = m_toneMap;
+    src.matrix = picture->matrix;
+    src.range = picture->range;
+
+    const QSize size = deliverySize(src.width, src.height);
+    const bool scaled = size != QSize(src.width, src.height);
+    if (scaled && !m_scaleFilter.matches(src.width, src.height, size.width(), size.height()))
+        m_scaleFilter = YuvConverter::makeScaleFilter(src.width, src.height, size.width(), size.height());
+
+    if (m_planarOutput.load(std::memory_order_acquire)) {
+        if (scaled) {
+            // Box/bilinear resample into a smaller picture from the same
+            // pool; the GPU then uploads and converts only what is shown.
+            const int bytesPerSample = picture->bitDepth > 8 ? 2 : 1;
+            const int pitchY = (size.width() * bytesPerSample + 63) & ~63;
+            const int pitchC = (size.width() / 2 * bytesPerSample + 63) & ~63;
+            const int pitches[3] = { pitchY, pitchC, pitchC };
+            const int lines[3] = { size.height(), size.height() / 2, size.height() / 2 };
+            std::shared_ptr<VideoPicture> small = VideoPicture::create(
+                m_bufferPool, size.width(), size.height(), pitches, lines, picture->bitDepth);
+            if (!small)
+                return;
+            small->matrix = picture->matrix;
+            small->range = picture->range;
+            const YuvConverter::ScaleFilter& filter = m_scaleFilter;
+            uint8_t* const planes[3] = { small->planes[0], small->planes[1], small->planes[2] };
+            m_frameSlicer.run(size.width(), size.height(), [&src, &filter, &planes, &pitches](int rowBegin, int rowEnd) {
+                YuvConverter::scaleI420Rows(src, filter, planes, pitches, rowBegin, rowEnd);
+            });
+            picture = std::move(small);
+        }
 
-    if (!m_videoSink || !m_planeY || !m_planeU || !m_planeV ||
-        m_videoWidth <= 0 || m_videoHeight <= 0)
+        // The sink's RHI shader does the YUV→RGB conversion on the GPU,
+        // sampling the planes VLC decoded into (or their scaled copy).
+        QVideoFrameFormat::ColorTransfer transfer = QVideoFrameFormat::ColorTransfer_Unknown;
+        if (m_toneMap == YuvConverter::ToneMap::Pq)
+            transfer = QVideoFrameFormat::ColorTransfer_ST2084;
+        else if (m_toneMap == YuvConverter::ToneMap::Hlg)
+            transfer = QVideoFrameFormat::ColorTransfer_STD_B67;
+        m_videoSink->setVideoFrame(QVideoFrame(std::make_unique<VideoFrameBuffer>(std::move(picture), transfer)));
+        m_sessionLog.recordFirstFrame();
+        const qint64 end = FramePacer::now();
+        m_frameStats.recordDelivery(end - presentationTime, end - start);
+        m_framePacer.framePresented(presentationTime);
         return;
+    }
 
-    // CPU YUV420 → BGRA (BT.601 limited range).
-    QVideoFrameFormat format(QSize(m_videoWidth, m_videoHeight),
-                             QVideoFrameFormat::Format_BGRA8888);
+    // CPU YUV420 → BGRA with the matrix and range picked at format
+    // negotiation; 10-bit rows are narrowed, and tone-mapped
+    // if configured, on the way in. The row kernel (SSE2/AVX2/NEON or the
+    // scalar reference) is picked once from the CPU's features; 4K and other
+    // large frames are split into row slices converted on several cores.
+    // Downscaled frames are resampled and converted in the same pass.
+    QVideoFrameFormat format(size, QVideoFrameFormat::Format_BGRA8888);
     QVideoFrame frame(format);
     if (!frame.map(QVideoFrame::WriteOnly))
         return;
 
+    uint8_t* dst = frame.bits(0);
     const int dstPitch = frame.bytesPerLine(0);
-    uchar* dst = frame.bits(0);
-
-    for (int y = 0; y < m_videoHeight; ++y) {
-        const uchar* yRow = m_planeY + y * m_pitchY;
-        const uchar* uRow = m_planeU + (y / 2) * m_pitchU;
-        const uchar* vRow = m_planeV + (y / 2) * m_pitchV;
-        uchar* dstRow = dst + y * dstPitch;
-
-        for (int x = 0; x < m_videoWidth; ++x) {
-            const int Y = yRow[x];
-            const int U = uRow[x / 2] - 128;
-            const int V = vRow[x / 2] - 128;
-
-            int r = (Y << 10) + 1436 * V;
-            int g = (Y << 10) - 352 * U - 731 * V;
-            int b = (Y << 10) + 1814 * U;
-
-            r = std::clamp(r >> 10, 0, 255);
-            g = std::clamp(g >> 10, 0, 255);
-            b = std::clamp(b >> 10, 0, 255);
-
-            uchar* px = dstRow + x * 4;
-            px[0] = static_cast<uchar>(b);
-            px[1] = static_cast<uchar>(g);
-            px[2] = static_cast<uchar>(r);
-            px[3] = 0xFF;
-        }
+    if (scaled) {
+        const YuvConverter::ScaleFilter& filter = m_scaleFilter;
+        m_frameSlicer.run(size.width(), size.height(), [&src, &filter, dst, dstPitch](int rowBegin, int rowEnd) {
+            YuvConverter::convertI420ToBgraScaledRows(src, filter, dst, dstPitch, rowBegin, rowEnd);
+        });
+    } else {
+        m_frameSlicer.run(src.width, src.height, [&src, dst, dstPitch](int rowBegin, int rowEnd) {
+            YuvConverter::convertI420ToBgraRows(src, dst, dstPitch, rowBegin, rowEnd);
+        });
     }
 
     frame.unmap();
     m_videoSink->setVideoFrame(frame);
+    m_sessionLog.recordFirstFrame();
+    const qint64 end = FramePacer::now();
+    m_frameStats.recordDelivery(end - presentationTime, end - start);
+    m_framePacer.framePresented(presentationTime);
 }
 
 /**
@@ -651,6 +1210,15 @@ void VLCPlayerHandler::loadMedia(const QString& mediaId, const QVariantMap& medi
     if (!verifyVLCSetup()) {
         return;
     }
+    if (!m_currentMediaId.isEmpty()) {
+        m_cachingPolicy.finishSession();
+        if (mediaId != m_currentMediaId)
+            recordProgress("switch", true);
+        finishSession(mediaId != m_currentMediaId ? "switch" : "reload");
+    }
+    m_sessionLog.begin(mediaId);
+    m_streamStats.clear();
+    emit streamStatsChanged();
 
     float percentage_watched = 0;
     if (!mediaMetadata.isEmpty()) {
@@ -659,45 +1227,55 @@ void VLCPlayerHandler::loadMedia(const QString& mediaId, const QVariantMap& medi
     fullScreen = false;
     m_currentMediaId = mediaId;
     m_subtitleTracks.clear();
-
-    // Clean up existing media
-    if (m_media) {
-        libvlc_media_release(m_media);
-        m_media = nullptr;
+    m_audioTracks.clear();
+    emit subtitleTracksChanged();
+    emit audioTracksChanged();
+    m_length = 0;
+    setTime(0);
+    m_openClock.invalidate();
+    m_connectMs = -1;
+    m_startupMs = -1;
+    m_rebuffers = 0;
+    m_stalled = false;
+    m_seekPending = false;
+    m_seekTimer->stop();
+    m_seekTarget = -1;
+    m_videoTrackId = -1;
+    // The start gets the link to itself; previews resume from disk later.
+    m_thumbnails.stop();
+
+    if (takePreroll(mediaId)) {
+        fprintf(stderr, "[GHOST] loadMedia: switching to pre-rolled %s\n", mediaId.toUtf8().constData()); fflush(stderr);
+    } else {
+        cancelPreroll();
+        // Clean up existing media
+        if (m_media) {
+            libvlc_media_release(m_media);
+            m_media = nullptr;
+        }
+        m_media = createStreamMedia(mediaId);
+        if (m_media) {
+            libvlc_media_player_set_media(m_mediaPlayer, m_media);
+            // A pre-rolled stream has already connected, so only fresh opens
+            // say anything about the network.
+            m_openClock.start();
+        }
     }
 
-    // Create media URL and initialize
-    QString baseUrl = QString(m_url + "/stream/%1").arg(mediaId);
-    fprintf(stderr, "[GHOST] loadMedia URL: %s\n", baseUrl.toUtf8().constData()); fflush(stderr);
-    QByteArray urlBytes = baseUrl.toUtf8();
-    m_media = libvlc_media_new_location(m_vlcInstance, urlBytes.constData());
-    fprintf(stderr, "[GHOST] libvlc_media_new_location returned: %p\n", (void*)m_media); fflush(stderr);
-
     if (m_media) {
-        // Set media options
-        libvlc_media_add_option(m_media, ":network-caching=5000");
-        libvlc_media_add_option(m_media, ":http-reconnect");
-        // Force pure software decode. With video callbacks libVLC has to copy
-        // any HW-decoded surface back to CPU memory, and the VAOP→I420 chroma
-        // conversion truncates the bottom chroma rows on this stream — that's
-        // what produced the alternating green stripes at the bottom.
-        libvlc_media_add_option(m_media, ":avcodec-hw=none");
-        QByteArray authHeader = QString(":http-extra-headers=Authorization: Bearer %1\r\n").arg(m_token).toUtf8();
-        libvlc_media_add_option(m_media, authHeader.constData());
-
-        libvlc_media_player_set_media(m_mediaPlayer, m_media);
-
-        // Initialize subtitles and audio
+        m_mediaAudioOnly = m_audioOnly;
+        // Initialize subtitles and audio. Subtitle probes run alongside the
+        // stream open; the tracks are selected, and the UI told about them,
+        // once playback has actually started.
         tryDownloadSubtitles(mediaId);
+        m_pendingSubtitlesChoice = mediaMetadata.value("subtitles_chosen").toString();
+        m_pendingAudioChoice = mediaMetadata.value("language_chosen").toString();
+        m_subtitlesChoicePending = !m_pendingSubtitlesChoice.isEmpty();
+        m_audioChoicePending = !m_pendingAudioChoice.isEmpty();
+        m_tracksPending = true;
+        m_bufferingProgress = 0.0f;
+        emit bufferingProgressChanged(m_bufferingProgress);
         playMedia(percentage_watched);
-        loadSubtitleTracks(mediaMetadata.value("subtitles_chosen").toString());
-        loadAudioTracks(mediaMetadata.value("language_chosen").toString());
-
-        // Emit signals for UI updates
-        emit subtitleTracksChanged();
-        emit mediaLoaded();
-        libvlc_time_t duration = libvlc_media_player_get_length(m_mediaPlayer);
-        emit durationChanged(duration);
     }
     else {
         qDebug() << "Failed to create media";
@@ -706,67 +1284,298 @@ void VLCPlayerHandler::loadMedia(const QString& mediaId, const QVariantMap& medi
 }
 
 /**
- * @brief Downloads and adds subtitle tracks for the media
- * @param mediaId ID of the media to download subtitles for
- * @return bool True if subtitles were successfully downloaded
+ * @brief Creates the stream media for mediaId with the player's options
+ * @return The media, or nullptr if libVLC refused the URL
  */
-bool VLCPlayerHandler::tryDownloadSubtitles(const QString& mediaId) {
-    QList<QString> languages;
-    languages.append("es");
-    languages.append("en");
+libvlc_media_t* VLCPlayerHandler::createStreamMedia(const QString& mediaId) {
+    // Through the caching proxy when it runs; it adds the auth header itself.
+    QString baseUrl = m_streamProxy.isRunning() ? m_streamProxy.streamUrl(mediaId)
+                                                : QString(m_url + "/stream/%1").arg(mediaId);
+    fprintf(stderr, "[GHOST] stream URL: %s\n", baseUrl.toUtf8().constData()); fflush(stderr);
+    QByteArray urlBytes = baseUrl.toUtf8();
+    libvlc_media_t* media = libvlc_media_new_location(m_vlcInstance, urlBytes.constData());
+    fprintf(stderr, "[GHOST] libvlc_media_new_location returned: %p\n", (void*)media); fflush(stderr);
+    if (!media)
+        return nullptr;
+
+    // Set media options
+    const int cachingMs = m_cachingPolicy.cachingMs();
+    fprintf(stderr, "[GHOST] network-caching: %d ms\n", cachingMs); fflush(stderr);
+    libvlc_media_add_option(media, QString(":network-caching=%1").arg(cachingMs).toUtf8().constData());
+    libvlc_media_add_option(media, ":http-reconnect");
+    // Force pure software decode. With video callbacks libVLC has to copy
+    // any HW-decoded surface back to CPU memory, and the VAOP→I420 chroma
+    // conversion truncates the bottom chroma rows on this stream — that's
+    // what produced the alternating green stripes at the bottom.
+    libvlc_media_add_option(media, ":avcodec-hw=none");
+    if (!m_streamProxy.isRunning())  // the proxy adds it upstream
+        libvlc_media_add_option(media, authHeaderOption().toUtf8().constData());
+    // No video ES is selected, so no decoder, output or format negotiation.
+    if (m_audioOnly)
+        libvlc_media_add_option(media, ":no-video");
+    return media;
+}
 
-    for (const QString& language : languages) {
-        bool exist = true;
-        QUrl url(QString(m_url + "/media/%1/subtitles/%2").arg(mediaId, language + ".vtt"));
+QString VLCPlayerHandler::authHeaderOption() const {
+    return QString(":http-extra-headers=Authorization: Bearer %1\r\n").arg(m_token);
+}
 
-        // Verify subtitle availability
-        QNetworkAccessManager manager;
-        QNetworkRequest request(url);
-        QEventLoop loop;
-        QNetworkReply* reply = manager.get(request);
-        QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-        loop.exec();
-
-        int httpStatusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-        if (reply->error() != QNetworkReply::NoError || httpStatusCode != 200) {
-            qWarning() << "Subtitle URL does not exist or returned an error. Status code:" << httpStatusCode;
-            reply->deleteLater();
-            exist = false;
+void VLCPlayerHandler::startThumbnails() {
+    // A slice of the measured link, so previews never compete with playback.
+    const double throughput = m_cachingPolicy.throughputKbps();
+    m_thumbnails.setBandwidthLimit(throughput > 0.0 ? std::max(300.0, throughput * 0.1) : 1000.0);
+    m_thumbnails.setPaused(m_stalled);
+    m_thumbnails.start(m_currentMediaId, QString(m_url + "/stream/%1").arg(m_currentMediaId),
+                       { authHeaderOption() }, m_length);
+}
+
+QUrl VLCPlayerHandler::thumbnailAt(qint64 position) const {
+    return m_thumbnails.thumbnailAt(position);
+}
+
+/**
+ * @brief Routes a player's decoded frames into our QVideoSink instead of a
+ *        native window.
+ *
+ * Must be set before play; safe to set once for the player's lifetime.
+ */
+void VLCPlayerHandler::installVideoCallbacks(libvlc_media_player_t* player) {
+    libvlc_video_set_format_callbacks(player,
+                                      &VLCPlayerHandler::videoFormatCallback,
+                                      &VLCPlayerHandler::videoFormatCleanupCallback);
+    libvlc_video_set_callbacks(player,
+                               &VLCPlayerHandler::videoLockCallback,
+                               &VLCPlayerHandler::videoUnlockCallback,
+                               &VLCPlayerHandler::videoDisplayCallback,
+                               this);
+}
+
+// Video callbacks of a standby player until takePreroll() routes it into
+// the handler. A video output it opens early is refused, so it can never
+// write into m_frames or m_pictures alongside the playing player; vmem
+// also keeps VLC from opening a window of its own instead.
+static unsigned standbyFormatCallback(void** /*opaque*/, char* /*chroma*/, unsigned* /*width*/,
+                                      unsigned* /*height*/, unsigned* /*pitches*/, unsigned* /*lines*/) {
+    fprintf(stderr, "[GHOST] pre-roll: video output refused until the switch\n");
+    fflush(stderr);
+    return 0;
+}
+
+static void* standbyLockCallback(void* /*opaque*/, void** planes) {
+    // Unreachable: vmem doesn't open once the format is refused.
+    planes[0] = planes[1] = planes[2] = nullptr;
+    return nullptr;
+}
+
+static void installStandbyVideoCallbacks(libvlc_media_player_t* player) {
+    libvlc_video_set_format_callbacks(player, &standbyFormatCallback, nullptr);
+    libvlc_video_set_callbacks(player, &standbyLockCallback, nullptr, nullptr, nullptr);
+}
+
+void VLCPlayerHandler::attachPlayerEvents(libvlc_media_player_t* player) {
+    libvlc_event_manager_t* events = libvlc_media_player_event_manager(player);
+    for (libvlc_event_type_t type : kPlayerEvents) {
+        libvlc_event_attach(events, type, &VLCPlayerHandler::playerEventCallback, this);
+    }
+}
+
+void VLCPlayerHandler::detachPlayerEvents(libvlc_media_player_t* player) {
+    libvlc_event_manager_t* events = libvlc_media_player_event_manager(player);
+    for (libvlc_event_type_t type : kPlayerEvents) {
+        libvlc_event_detach(events, type, &VLCPlayerHandler::playerEventCallback, this);
+    }
+}
+
+void VLCPlayerHandler::setNextMediaId(const QString& mediaId) {
+    if (m_nextMediaId == mediaId)
+        return;
+    m_nextMediaId = mediaId;
+    // A held pre-roll stays until loadMedia() has decided whether to take
+    // it: QML moves to the next episode, which re-binds nextMediaId to the
+    // one after, just before it loads. updatePreroll() replaces it if
+    // playback carries on instead.
+    emit nextMediaIdChanged();
+}
+
+/**
+ * @brief Pre-rolls the next episode during the last minutes of this one
+ *
+ * Seeking back out of that window, or losing the next episode, cancels
+ * it; a different next episode replaces it.
+ */
+void VLCPlayerHandler::updatePreroll() {
+    constexpr qint64 kPrerollLeadMs = 2 * 60 * 1000;
+    const bool nearEnd = m_length > 0 && m_length - m_time <= kPrerollLeadMs;
+    if (nearEnd && !m_nextMediaId.isEmpty()) {
+        if (!m_prerollPlayer || m_prerollMediaId != m_nextMediaId)
+            startPreroll();
+    } else if (m_prerollPlayer) {
+        cancelPreroll();
+    }
+}
+
+/**
+ * @brief Opens the next episode on a standby player and leaves it paused
+ *
+ * ":start-paused" lets VLC connect, fill its read-ahead, probe the
+ * container and set up the decoders, then stop before the first picture is
+ * decoded. The standby player only gets the handler's video callbacks in
+ * takePreroll(), after the current one has stopped: they share m_frames,
+ * which has a single producer.
+ */
+void VLCPlayerHandler::startPreroll() {
+    cancelPreroll();
+    m_prerollMedia = createStreamMedia(m_nextMediaId);
+    if (!m_prerollMedia)
+        return;
+    libvlc_media_add_option(m_prerollMedia, ":start-paused");
+    m_prerollPlayer = libvlc_media_player_new_from_media(m_prerollMedia);
+    if (!m_prerollPlayer) {
+        libvlc_media_release(m_prerollMedia);
+        m_prerollMedia = nullptr;
+        return;
+    }
+    installStandbyVideoCallbacks(m_prerollPlayer);
+    libvlc_media_player_play(m_prerollPlayer);
+    m_prerollMediaId = m_nextMediaId;
+    fprintf(stderr, "[GHOST] pre-rolling next episode %s\n", m_prerollMediaId.toUtf8().constData());
+    fflush(stderr);
+}
+
+void VLCPlayerHandler::cancelPreroll() {
+    if (m_prerollPlayer) {
+        fprintf(stderr, "[GHOST] pre-roll of %s cancelled\n", m_prerollMediaId.toUtf8().constData());
+        fflush(stderr);
+        libvlc_media_player_stop(m_prerollPlayer);
+        libvlc_media_player_release(m_prerollPlayer);
+        m_prerollPlayer = nullptr;
+    }
+    if (m_prerollMedia) {
+        libvlc_media_release(m_prerollMedia);
+        m_prerollMedia = nullptr;
+    }
+    m_prerollMediaId.clear();
+}
+
+/**
+ * @brief Swaps the pre-rolled player in as the current one
+ *
+ * Only a standby player that reached its start-paused state is taken; one
+ * still opening (or failed) is dropped and the caller loads normally. The
+ * old player is stopped first so its video output closes before the new
+ * one opens; when the geometry matches, the new format keeps the pictures.
+ * libVLC 3 reads the video callbacks when the output is created, so
+ * installing them here, while the new player is still paused, is enough.
+ */
+bool VLCPlayerHandler::takePreroll(const QString& mediaId) {
+    if (!m_prerollPlayer || mediaId != m_prerollMediaId)
+        return false;
+    if (libvlc_media_player_get_state(m_prerollPlayer) != libvlc_Paused) {
+        cancelPreroll();
+        return false;
+    }
+
+    detachPlayerEvents(m_mediaPlayer);
+    libvlc_media_player_stop(m_mediaPlayer);
+    libvlc_media_player_release(m_mediaPlayer);
+    if (m_media)
+        libvlc_media_release(m_media);
+
+    m_mediaPlayer = m_prerollPlayer;
+    m_media = m_prerollMedia;
+    m_prerollPlayer = nullptr;
+    m_prerollMedia = nullptr;
+    m_prerollMediaId.clear();
+    installVideoCallbacks(m_mediaPlayer);
+    attachPlayerEvents(m_mediaPlayer);
+    if (m_volume >= 0)
+        libvlc_audio_set_volume(m_mediaPlayer, m_volume);
+    return true;
+}
+
+/**
+ * @brief Looks up subtitle tracks for the media without blocking
+ * @param mediaId ID of the media to find subtitles for
+ *
+ * Languages come from conf.ini (subtitleLanguages, default "es,en"). A
+ * language already in the on-disk cache is attached straight away; the rest
+ * are requested together on the shared network manager and attached, and
+ * cached, as each reply arrives. Replies for media no longer loaded are
+ * ignored.
+ */
+void VLCPlayerHandler::tryDownloadSubtitles(const QString& mediaId) {
+    for (const QString& language : m_subtitleLanguages) {
+        const QString cachePath = subtitleCachePath(mediaId, language);
+        if (QFileInfo::exists(cachePath)) {
+            attachSubtitle(language, QUrl::fromLocalFile(cachePath));
+            continue;
         }
-        if (exist) {
+
+        QUrl url(QString(m_url + "/media/%1/subtitles/%2").arg(mediaId, language + ".vtt"));
+        QNetworkReply* reply = m_networkManager.get(QNetworkRequest(url));
+        ++m_pendingSubtitles;
+        connect(reply, &QNetworkReply::finished, this, [this, reply, mediaId, language, cachePath]() {
             reply->deleteLater();
+            --m_pendingSubtitles;
+            if (mediaId != m_currentMediaId)
+                return;
 
-            // Add subtitle track to media player
-            if (m_mediaPlayer) {
-                QByteArray urlBytes = url.toString().toUtf8();
-                const char* charurl = urlBytes.constData();
-                qDebug() << charurl;
-
-                int result = libvlc_media_player_add_slave(
-                    m_mediaPlayer,
-                    libvlc_media_slave_type_subtitle,
-                    charurl,
-                    false
-                );
-
-                qDebug() << "Result of adding subtitle:" << result;
-                if (result != 0) {
-                    qWarning() << "Failed to add subtitle track:" << language << "Error code:" << result;
-                }
+            int httpStatusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (reply->error() != QNetworkReply::NoError || httpStatusCode != 200) {
+                qWarning() << "Subtitle URL does not exist or returned an error. Status code:" << httpStatusCode;
+                return;
             }
-            else {
-                qWarning() << "Media player is not initialized.";
-                return false;
+
+            // Keep a copy so the next play of this media needs no request,
+            // and hand VLC the local file rather than fetching it twice.
+            const QByteArray body = reply->readAll();
+            QDir().mkpath(QFileInfo(cachePath).absolutePath());
+            QSaveFile file(cachePath);
+            if (file.open(QIODevice::WriteOnly) && file.write(body) == body.size() && file.commit()) {
+                attachSubtitle(language, QUrl::fromLocalFile(cachePath));
+            } else {
+                qWarning() << "Could not cache subtitle" << cachePath;
+                attachSubtitle(language, reply->url());
             }
-        }
-        
+        });
     }
-    return true;
 }
 
 /**
- * @brief Loads and initializes subtitle tracks
- * @param subtitles_chosen Previously selected subtitle track
+ * @brief Adds one subtitle track to the player
+ *
+ * Before playback starts VLC attaches it to the media; afterwards it opens
+ * it in the running input and reports it with ESAdded.
+ */
+void VLCPlayerHandler::attachSubtitle(const QString& language, const QUrl& location) {
+    if (!m_mediaPlayer) {
+        qWarning() << "Media player is not initialized.";
+        return;
+    }
+    QByteArray urlBytes = location.toString(QUrl::FullyEncoded).toUtf8();
+    int result = libvlc_media_player_add_slave(
+        m_mediaPlayer,
+        libvlc_media_slave_type_subtitle,
+        urlBytes.constData(),
+        false
+    );
+    qDebug() << "Result of adding subtitle:" << urlBytes.constData() << result;
+    if (result != 0) {
+        qWarning() << "Failed to add subtitle track:" << language << "Error code:" << result;
+    }
+}
+
+QString VLCPlayerHandler::subtitleCachePath(const QString& mediaId, const QString& language) {
+    // Media IDs come from the server; keep them from escaping the cache dir.
+    QString safeId = mediaId;
+    safeId.replace(QRegularExpression("[^A-Za-z0-9_.-]"), "_");
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+        + "/subtitles/" + safeId + "/" + language + ".vtt";
+}
+
+/**
+ * @brief Rebuilds the subtitle track list from the player
+ * @param subtitles_chosen Previously selected subtitle track, applied once it exists
  */
 void VLCPlayerHandler::loadSubtitleTracks(QString subtitles_chosen) {
     m_subtitleTracks.clear();
@@ -775,6 +1584,7 @@ void VLCPlayerHandler::loadSubtitleTracks(QString subtitles_chosen) {
 
     m_currentSubtitlesId = libvlc_video_get_spu(m_mediaPlayer);
     int metadataSubtitleId = m_currentSubtitlesId;
+    bool chosenFound = false;
 
     // Get subtitle track descriptions
     libvlc_track_description_t* tracks = libvlc_video_get_spu_description(m_mediaPlayer);
@@ -789,8 +1599,9 @@ void VLCPlayerHandler::loadSubtitleTracks(QString subtitles_chosen) {
         if (trackInfo["id"] == m_currentSubtitlesId) {
             m_currentSubtitlesText = trackInfo["name"].toString();
         }
-        else if (trackInfo["name"] == subtitles_chosen) {
+        if (m_subtitlesChoicePending && trackInfo["name"] == subtitles_chosen) {
             metadataSubtitleId = trackInfo["id"].toInt();
+            chosenFound = true;
         }
 
         if (trackInfo["id"] != -1) {
@@ -804,9 +1615,13 @@ void VLCPlayerHandler::loadSubtitleTracks(QString subtitles_chosen) {
         libvlc_track_description_list_release(tracks);
     }
 
-    // Set subtitle track if different from current
-    if (metadataSubtitleId != m_currentSubtitlesId) {
-        setSubtitleTrack(metadataSubtitleId);
+    // Applied while the track is new, so there is no decoder to flush.
+    if (chosenFound) {
+        m_subtitlesChoicePending = false;
+        if (metadataSubtitleId != m_currentSubtitlesId) {
+            libvlc_video_set_spu(m_mediaPlayer, metadataSubtitleId);
+            updateSubtitleSelected();
+        }
     }
 
     reorderListById(m_subtitleTracks, m_currentSubtitlesId);
@@ -820,9 +1635,11 @@ void VLCPlayerHandler::loadSubtitleTracks(QString subtitles_chosen) {
 void VLCPlayerHandler::setSubtitleTrack(int trackId) {
     if (!m_mediaPlayer) return;
 
+    m_subtitlesChoicePending = false;  // the user's pick wins
     libvlc_video_set_spu(m_mediaPlayer, trackId);
     qDebug() << "Setting subtitles track to:" << trackId;
     updateSubtitleSelected();
+    recordProgress("track", true);
 }
 
 /**
@@ -842,6 +1659,109 @@ QVariantList VLCPlayerHandler::subtitleTracks() const {
     return m_subtitleTracks;
 }
 
+void VLCPlayerHandler::sampleFrameStats() {
+    const double seconds = m_statsClock.restart() / 1000.0;
+    m_frameStatsSample = m_frameStats.sample(m_frames.published(), m_frames.dropped(), seconds);
+    sampleNetwork(seconds);
+    m_frameStatsSample["startupMs"] = m_startupMs;
+    m_frameStatsSample["rebuffers"] = m_rebuffers;
+    m_frameStatsSample["networkCachingMs"] = m_cachingPolicy.cachingMs();
+    emit frameStatsChanged();
+
+    // A line every 30 s while frames are flowing.
+    if (++m_statsTicks % 30 == 0 && m_frameStatsSample["deliveredFps"].toDouble() > 0.0) {
+        fprintf(stderr, "[GHOST] frames: %llu decoded, %llu delivered, %llu dropped, %.1f fps |"
+                        " latency %.1f ms mean %.1f ms max | convert p50 %.2f p99 %.2f ms | lock %.3f ms max\n",
+                m_frameStatsSample["decodedFrames"].toULongLong(),
+                m_frameStatsSample["deliveredFrames"].toULongLong(),
+                m_frameStatsSample["droppedFrames"].toULongLong(),
+                m_frameStatsSample["deliveredFps"].toDouble(),
+                m_frameStatsSample["latencyMeanMs"].toDouble(),
+                m_frameStatsSample["latencyMaxMs"].toDouble(),
+                m_frameStatsSample["conversionP50Ms"].toDouble(),
+                m_frameStatsSample["conversionP99Ms"].toDouble(),
+                m_frameStatsSample["lockMaxMs"].toDouble());
+        fflush(stderr);
+    }
+}
+
+void VLCPlayerHandler::sampleNetwork(double seconds) {
+    libvlc_media_stats_t stats;
+    if (!m_media || seconds <= 0.0 || !libvlc_media_get_stats(m_media, &stats))
+        return;
+    // libVLC reports rates in bytes per microsecond.
+    m_streamStats["inputBitrateKbps"] = qRound(stats.f_input_bitrate * 8000.0);
+    m_streamStats["demuxBitrateKbps"] = qRound(stats.f_demux_bitrate * 8000.0);
+    m_streamStats["readBytes"] = static_cast<qlonglong>(stats.i_read_bytes);
+    m_streamStats["displayedPictures"] = stats.i_displayed_pictures;
+    m_streamStats["lostPictures"] = stats.i_lost_pictures;
+    m_streamStats["lostAudioBuffers"] = stats.i_lost_abuffers;
+    m_streamStats["demuxCorrupted"] = stats.i_demux_corrupted;
+    m_streamStats["demuxDiscontinuities"] = stats.i_demux_discontinuity;
+    emit streamStatsChanged();
+    const qint64 readBytes = stats.i_read_bytes;
+    const qint64 delta = readBytes - m_readBytes;
+    const bool sameInput = m_media == m_statsMedia && delta >= 0;
+    const bool advanced = m_time != m_sampledTime;
+    m_statsMedia = m_media;
+    m_readBytes = readBytes;
+    m_sampledTime = m_time;
+    if (!sameInput)
+        return;  // new input: this sample only sets the baseline
+
+    if (advanced)
+        m_seekPending = false;
+    if (!m_isPlaying || m_starting || m_seekPending) {
+        m_stillSamples = 0;
+        return;
+    }
+    // VLC 3 often starves the decoders without announcing a rebuffer, so
+    // a clock standing still for two samples while playing is a stall too.
+    m_stillSamples = advanced ? 0 : m_stillSamples + 1;
+    if (advanced)
+        setStalled(false);
+    else if (m_stillSamples >= 2)
+        setStalled(true);
+    if (m_stalled) {
+        // Loopback reads when streaming through the proxy (see finishPlaybackStart).
+        if (delta > 0 && !m_streamProxy.isRunning())
+            m_cachingPolicy.recordThroughput(delta * 8.0 / 1000.0 / seconds);
+    } else {
+        m_cachingPolicy.recordBitrate(stats.f_demux_bitrate * 8000.0);  // bytes/µs → kb/s
+        m_sessionLog.recordBitrate(stats.f_demux_bitrate * 8000.0, seconds);
+    }
+}
+
+void VLCPlayerHandler::setStalled(bool stalled) {
+    if (stalled == m_stalled)
+        return;
+    m_stalled = stalled;
+    m_thumbnails.setPaused(stalled);
+    if (!stalled) {
+        m_sessionLog.recordStallEnd();
+    } else {
+        m_sessionLog.recordStallStart();
+        ++m_rebuffers;
+        m_cachingPolicy.recordRebuffer();
+        fprintf(stderr, "[GHOST] playback stalled (%d so far); next network-caching %d ms\n",
+                m_rebuffers, m_cachingPolicy.cachingMs());
+        fflush(stderr);
+    }
+}
+
+void VLCPlayerHandler::finishSession(const QString& reason) {
+    QVariantMap extra;
+    extra["audioOnly"] = m_mediaAudioOnly;
+    extra["streamCache"] = m_streamProxy.isRunning();
+    m_sessionLog.finish(reason, m_streamStats, extra);
+}
+
+QVariantMap VLCPlayerHandler::pacingStats() const {
+    QVariantMap stats = m_framePacer.stats();
+    stats["dropped"] = static_cast<qulonglong>(m_frames.dropped());
+    return stats;
+}
+
 /**
  * @brief Returns the list of available audio tracks
  * @return QVariantList List of audio track information
@@ -898,7 +1818,7 @@ void VLCPlayerHandler::updateAudioSelected() {
 void VLCPlayerHandler::updateSubtitleSelected() {
     m_currentSubtitlesId = libvlc_video_get_spu(m_mediaPlayer);
 
-    libvlc_track_description_t* tracks = libvlc_audio_get_track_description(m_mediaPlayer);
+    libvlc_track_description_t* tracks = libvlc_video_get_spu_description(m_mediaPlayer);
     libvlc_track_description_t* currentTrack = tracks;
 
     while (currentTrack) {
@@ -914,8 +1834,8 @@ void VLCPlayerHandler::updateSubtitleSelected() {
 }
 
 /**
- * @brief Loads and initializes audio tracks
- * @param languageChosen Previously selected audio language
+ * @brief Rebuilds the audio track list from the player
+ * @param languageChosen Previously selected audio language, applied once it exists
  */
 void VLCPlayerHandler::loadAudioTracks(QString languageChosen) {
     m_audioTracks.clear();
@@ -924,6 +1844,7 @@ void VLCPlayerHandler::loadAudioTracks(QString languageChosen) {
 
     m_currentAudioId = libvlc_audio_get_track(m_mediaPlayer);
     int metadataAudioId = m_currentAudioId;
+    bool chosenFound = false;
 
     libvlc_track_description_t* tracks = libvlc_audio_get_track_description(m_mediaPlayer);
     libvlc_track_description_t* currentTrack = tracks;
@@ -936,8 +1857,9 @@ void VLCPlayerHandler::loadAudioTracks(QString languageChosen) {
         if (trackInfo["id"] == m_currentAudioId) {
             m_currentAudioText = trackInfo["name"].toString();
         }
-        else if (trackInfo["name"] == languageChosen) {
+        if (m_audioChoicePending && trackInfo["name"] == languageChosen) {
             metadataAudioId = trackInfo["id"].toInt();
+            chosenFound = true;
         }
 
         if (trackInfo["id"] != -1) {
@@ -951,8 +1873,12 @@ void VLCPlayerHandler::loadAudioTracks(QString languageChosen) {
         libvlc_track_description_list_release(tracks);
     }
 
-    if (metadataAudioId != m_currentAudioId) {
-        setAudioTrack(metadataAudioId);
+    if (chosenFound) {
+        m_audioChoicePending = false;
+        if (metadataAudioId != m_currentAudioId) {
+            libvlc_audio_set_track(m_mediaPlayer, metadataAudioId);
+            updateAudioSelected();
+        }
     }
 
     reorderListById(m_audioTracks, m_currentAudioId);
@@ -966,9 +1892,11 @@ void VLCPlayerHandler::loadAudioTracks(QString languageChosen) {
 void VLCPlayerHandler::setAudioTrack(int trackId) {
     if (!m_mediaPlayer) return;
 
+    m_audioChoicePending = false;  // the user's pick wins
     libvlc_audio_set_track(m_mediaPlayer, trackId);
     qDebug() << "Setting audio track to:" << trackId;
     updateAudioSelected();
+    recordProgress("track", true);
 }
 
 /**
@@ -6,10 +6,26 @@
 #include <QString>
 #include <QVideoSink>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QQuickItem>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
-#include <QMutex>
+#include <QPointer>
+#include <QSize>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "FramePacer.h"
+#include "FrameStats.h"
+#include "FrameSlicer.h"
+#include "NetworkCachingPolicy.h"
+#include "ProgressJournal.h"
+#include "SessionLog.h"
+#include "StreamProxy.h"
+#include "ThumbnailExtractor.h"
+#include "TripleBuffer.h"
+#include "VideoFrameBuffer.h"
+#include "YuvConverter.h"
 
 /**
  * @brief Handles video playback using VLC backend in a Qt/QML application
@@ -20,28 +36,64 @@
  */
 class VLCPlayerHandler : public QObject {
     Q_OBJECT
+        // Drives the video callbacks directly (FramePipelineBenchmark.cpp)
+        friend class FramePipelineBenchmark;
+
         // Duration of the current media in milliseconds
         Q_PROPERTY(qint64 duration READ duration NOTIFY durationChanged)
         // Current playback position in milliseconds
         Q_PROPERTY(qint64 position READ position WRITE setPosition NOTIFY positionChanged)
         // Current playing state of the media
         Q_PROPERTY(bool isPlaying READ isPlaying NOTIFY playingStateChanged)
+        // Stream buffering while opening or stalled, 0-100
+        Q_PROPERTY(float bufferingProgress READ bufferingProgress NOTIFY bufferingProgressChanged)
+        // Episode to pre-roll near the end of this one; empty for none
+        Q_PROPERTY(QString nextMediaId READ nextMediaId WRITE setNextMediaId NOTIFY nextMediaIdChanged)
         // Video sink for rendering output
         Q_PROPERTY(QVideoSink* videoSink READ videoSink WRITE setVideoSink NOTIFY videoSinkChanged)
+        // Item the frames are shown in; its size caps the resolution of delivered frames
+        Q_PROPERTY(QQuickItem* videoOutput READ videoOutput WRITE setVideoOutput NOTIFY videoOutputChanged)
         // Available subtitle tracks
         Q_PROPERTY(QVariantList subtitleTracks READ subtitleTracks NOTIFY subtitleTracksChanged)
         // Available audio tracks
         Q_PROPERTY(QVariantList audioTracks READ audioTracks NOTIFY audioTracksChanged)
+        // Frame pipeline health, refreshed once a second (see FrameStats::sample),
+        // plus startupMs, rebuffers and networkCachingMs for the current media
+        Q_PROPERTY(QVariantMap frameStats READ frameStats NOTIFY frameStatsChanged)
+        // libVLC input counters of the current media, refreshed once a second:
+        // inputBitrateKbps, demuxBitrateKbps, readBytes, displayedPictures,
+        // lostPictures, lostAudioBuffers, demuxCorrupted, demuxDiscontinuities
+        Q_PROPERTY(QVariantMap streamStats READ streamStats NOTIFY streamStatsChanged)
+        // Seek-bar preview thumbnails ready for the current media
+        Q_PROPERTY(int thumbnailCount READ thumbnailCount NOTIFY thumbnailsChanged)
         // Fullscreen toggle (drives QML layout: hides the controls strip)
         Q_PROPERTY(bool fullScreen READ isFullScreen WRITE setFullScreen NOTIFY fullScreenChanged)
+        // Audio-only playback: no video is decoded, converted or delivered
+        Q_PROPERTY(bool audioOnly READ audioOnly WRITE setAudioOnly NOTIFY audioOnlyChanged)
 
 public:
+    /** @brief How much of the app's environment a handler takes part in */
+    enum class Mode {
+        Normal,
+        // Only libVLC and the frame path: conf.ini is not read, and there is
+        // no stream proxy, progress journal or server sync. For tools such
+        // as FramePipelineBenchmark.
+        Headless,
+    };
+
     /**
      * @brief Constructs the VLC player handler
      * @param parent Parent QObject for memory management
      */
     explicit VLCPlayerHandler(QObject* parent = nullptr);
 
+    /**
+     * @brief Constructs the VLC player handler in the given mode
+     * @param mode Normal, or Headless for tools that must not touch user state
+     * @param parent Parent QObject for memory management
+     */
+    explicit VLCPlayerHandler(Mode mode, QObject* parent = nullptr);
+
     /**
      * @brief Destructor that ensures proper cleanup of VLC resources
      */
@@ -56,12 +108,51 @@ public:
     /** @brief Returns whether media is currently playing */
     bool isPlaying() const;
 
+    /** @brief Last buffering percentage VLC reported (0-100) */
+    float bufferingProgress() const { return m_bufferingProgress; }
+
+    /** @brief Episode that plays after this one, if any */
+    QString nextMediaId() const { return m_nextMediaId; }
+
+    /**
+     * @brief Sets the episode to pre-roll during the end of this one
+     * @param mediaId Next episode's ID, or empty to disable pre-roll
+     */
+    void setNextMediaId(const QString& mediaId);
+
     /** @brief Gets the current video sink */
     QVideoSink* videoSink() const;
 
+    /** @brief Gets the item the video is displayed in */
+    QQuickItem* videoOutput() const;
+
     /** @brief Gets the list of available subtitle tracks */
     QVariantList subtitleTracks() const;
 
+    /**
+     * @brief Frame pacing statistics for the current video
+     *
+     * Latency is measured from VLC's display request to the buffer swap
+     * that put the frame on screen; see FramePacer::stats() for the keys.
+     */
+    Q_INVOKABLE QVariantMap pacingStats() const;
+
+    /** @brief Latest once-a-second sample of the frame pipeline counters */
+    QVariantMap frameStats() const { return m_frameStatsSample; }
+
+    /** @brief Latest libVLC input and decoder counters of the current media */
+    QVariantMap streamStats() const { return m_streamStats; }
+
+    /** @brief Number of seek-bar thumbnails ready for the current media */
+    int thumbnailCount() const { return m_thumbnails.available(); }
+
+    /**
+     * @brief Preview image for a seek-bar position
+     * @param position Position in milliseconds
+     * @return File URL of the nearest extracted thumbnail, or an empty URL
+     */
+    Q_INVOKABLE QUrl thumbnailAt(qint64 position) const;
+
     /**
      * @brief Sets the active subtitle track
      * @param trackId ID of the subtitle track to activate
@@ -102,6 +193,15 @@ public:
     /** @brief Whether fullscreen mode is currently active */
     bool isFullScreen() const { return fullScreen; }
 
+    /**
+     * @brief Switches audio-only playback on or off
+     * @param audioOnly True to stop decoding video, false to show it again
+     */
+    Q_INVOKABLE void setAudioOnly(bool audioOnly);
+
+    /** @brief Whether video decoding is switched off */
+    bool audioOnly() const { return m_audioOnly; }
+
     /**
      * @brief Sets the playback volume
      * @param volume Volume level to set
@@ -120,17 +220,35 @@ public:
 
 public slots:
     /**
-     * @brief Sets the playback position
+     * @brief Seeks exactly to a position
      * @param position Position in milliseconds
+     *
+     * The position property changes at once; VLC is asked once the requests
+     * stop arriving for a moment, so rapid calls cost a single seek.
      */
     void setPosition(qint64 position);
 
+    /**
+     * @brief Seeks to the keyframe nearest a position, for scrubbing previews
+     * @param position Position in milliseconds
+     *
+     * Merged like setPosition(); finish a drag with setPosition() to land on
+     * the exact frame.
+     */
+    void scrubTo(qint64 position);
+
     /**
      * @brief Sets the video sink for rendering
      * @param sink Video sink to use
      */
     void setVideoSink(QVideoSink* sink);
 
+    /**
+     * @brief Sets the item the video is displayed in
+     * @param item VideoOutput item whose size frames are scaled down to
+     */
+    void setVideoOutput(QQuickItem* item);
+
     /**
      * @brief Starts media playback
      * @param percentage_watched Starting position as percentage
@@ -156,6 +274,9 @@ signals:
     /** @brief Emitted when fullscreen state changes */
     void fullScreenChanged(bool fullScreen);
 
+    /** @brief Emitted when audio-only playback is switched on or off */
+    void audioOnlyChanged();
+
     /** @brief Emitted when playback position changes */
     void positionChanged(qint64 position);
 
@@ -165,6 +286,12 @@ signals:
     /** @brief Emitted when actual playing state changes */
     void reallyPlayingStateChanged(bool isReallyPlaying);
 
+    /** @brief Emitted when VLC reports buffering progress */
+    void bufferingProgressChanged(float progress);
+
+    /** @brief Emitted when the episode to pre-roll changes */
+    void nextMediaIdChanged();
+
     /** @brief Emitted when an error occurs */
     void errorOccurred(const QString& error);
 
@@ -177,12 +304,24 @@ signals:
     /** @brief Emitted when video sink changes */
     void videoSinkChanged();
 
+    /** @brief Emitted when the video output item changes */
+    void videoOutputChanged();
+
     /** @brief Emitted when subtitle tracks change */
     void subtitleTracksChanged();
 
     /** @brief Emitted when audio tracks change */
     void audioTracksChanged();
 
+    /** @brief Emitted once a second with a new frameStats sample */
+    void frameStatsChanged();
+
+    /** @brief Emitted when streamStats has been refreshed */
+    void streamStatsChanged();
+
+    /** @brief Emitted when seek-bar thumbnails are added or dropped */
+    void thumbnailsChanged();
+
     /** @brief Emitted when playback progress updates */
     void progressUpdated(float percentage);
 
@@ -190,6 +329,21 @@ private slots:
     /** @brief Pushes the latest decoded frame into the QVideoSink (GUI thread) */
     void deliverFrame();
 
+    /** @brief Re-reads the video item's size in physical pixels */
+    void updateOutputSize();
+
+    /** @brief Refreshes frameStats from the pipeline counters */
+    void sampleFrameStats();
+
+    /** @brief Gives up on a playMedia() that never reached Playing */
+    void onStartTimeout();
+
+    /** @brief Emits the newest TimeChanged position, at most once per refresh */
+    void publishTime();
+
+    /** @brief Sends the merged seek target to VLC */
+    void applySeek();
+
 private:
     /** @brief Cleans up VLC resources */
     void cleanupVLC();
@@ -199,6 +353,54 @@ private:
     /** @brief Releases the idle inhibitor. Safe to call when no inhibit is held. */
     void uninhibitIdle();
 
+    // libVLC player events — invoked on a VLC thread, handled on the GUI thread
+    static void playerEventCallback(const libvlc_event_t* event, void* opaque);
+    /** @brief value is the buffering percentage or the new length in ms */
+    void handlePlayerEvent(int type, double value);
+    /** @brief An elementary stream of esType was added, removed or selected */
+    void handleTrackEvent(int esType);
+
+    /** @brief Moves the position to target now and queues the VLC seek */
+    void requestSeek(qint64 target, bool fast);
+    /** @brief Updates the cached position and notifies QML if it moved */
+    void setTime(qint64 time);
+    /** @brief Applies the resume seek and pending track setup once started */
+    void finishPlaybackStart(bool playing);
+
+    /** @brief New stream media for mediaId with the usual options, or nullptr */
+    libvlc_media_t* createStreamMedia(const QString& mediaId);
+    /** @brief Media option carrying the server's auth header */
+    QString authHeaderOption() const;
+    /** @brief Starts thumbnail extraction for the current media */
+    void startThumbnails();
+    /** @brief Reads conf.ini and starts the stream proxy and progress sync */
+    void loadSettings();
+    /**
+     * @brief Journals the current watch progress for the server
+     * @param event What caused it ("pause", "seek", "periodic", ...)
+     * @param urgent Send within seconds rather than with the next periodic flush
+     */
+    void recordProgress(const QString& event, bool urgent);
+    /** @brief Feeds the caching policy from the input's read statistics */
+    void sampleNetwork(double seconds);
+    /** @brief Enters or leaves a mid-playback stall, counting each one */
+    void setStalled(bool stalled);
+    /** @brief Writes the QoE record of the running session, if any */
+    void finishSession(const QString& reason);
+    /** @brief Routes a player's video into this handler */
+    void installVideoCallbacks(libvlc_media_player_t* player);
+    void attachPlayerEvents(libvlc_media_player_t* player);
+    void detachPlayerEvents(libvlc_media_player_t* player);
+
+    /** @brief Starts or cancels the pre-roll for the current position */
+    void updatePreroll();
+    /** @brief Opens m_nextMediaId paused on a standby player */
+    void startPreroll();
+    /** @brief Drops the standby player, if any */
+    void cancelPreroll();
+    /** @brief Makes the standby player current; true if it held mediaId */
+    bool takePreroll(const QString& mediaId);
+
     // libVLC video callbacks — invoked on VLC's video output thread
     static unsigned videoFormatCallback(void** opaque, char* chroma,
                                         unsigned* width, unsigned* height,
@@ -208,8 +410,16 @@ private:
     static void videoUnlockCallback(void* opaque, void* picture, void* const* planes);
     static void videoDisplayCallback(void* opaque, void* picture);
 
-    /** @brief Updates media information */
-    void updateMediaInfo();
+    /**
+     * @brief Size to deliver a width × height picture at
+     *
+     * The picture's size unless the video item shows it noticeably smaller,
+     * in which case the aspect-fit size inside the item (GUI thread only).
+     */
+    QSize deliverySize(int width, int height) const;
+
+    /** @brief Picks a picture no frame references (video output thread only) */
+    std::shared_ptr<VideoPicture> acquirePicture();
 
     /** @brief Updates media metadata on the server */
     void updateMediaMetadataOnServer();
@@ -217,8 +427,19 @@ private:
     /** @brief Verifies VLC setup is complete */
     bool verifyVLCSetup();
 
-    /** @brief Attempts to download subtitles for media */
-    bool tryDownloadSubtitles(const QString& mediaId);
+    /**
+     * @brief Finds the server's subtitles for media without blocking
+     *
+     * Cached files are attached immediately; every other configured
+     * language is probed concurrently and attached when its reply arrives.
+     */
+    void tryDownloadSubtitles(const QString& mediaId);
+
+    /** @brief Adds a subtitle file or URL to the player as a slave track */
+    void attachSubtitle(const QString& language, const QUrl& location);
+
+    /** @brief Local path a media's subtitle language is cached at */
+    static QString subtitleCachePath(const QString& mediaId, const QString& language);
 
     /** @brief Loads subtitle tracks with given preference */
     void loadSubtitleTracks(QString subtitles_chosen);
@@ -232,7 +453,7 @@ private:
     /** @brief Updates selected subtitle track status */
     void updateSubtitleSelected();
 
-    // VLC instance and player pointers
+    // VLC instance (retained VlcInstance) and player pointers
     libvlc_instance_t* m_vlcInstance;
     libvlc_media_player_t* m_mediaPlayer;
     libvlc_media_t* m_media;
@@ -252,9 +473,68 @@ private:
     QVideoSink* m_videoSink;
 
     // Timers for various updates
-    QTimer* m_positionTimer;
     QTimer* m_metadataTimer;
     QTimer* m_loadingTimer;
+    QTimer* m_statsTimer;
+    QTimer* m_startTimeoutTimer;
+
+    // Asynchronous playback start: playMedia() only asks VLC to play, the
+    // rest happens when libvlc_MediaPlayerPlaying arrives.
+    bool m_starting = false;
+    float m_resumePosition = 0.0f;   // seek target (0-1) applied on start
+    bool m_tracksPending = false;    // loadMedia's track setup still to run
+    QString m_pendingSubtitlesChoice;
+    QString m_pendingAudioChoice;
+    bool m_subtitlesChoicePending = false;  // stored choice not yet matched to a track
+    bool m_audioChoicePending = false;
+    float m_bufferingProgress = 0.0f;
+
+    // Network caching for the next media opened, learnt from how this one
+    // opened (m_openClock: time to first buffered data, bytes read until
+    // Playing), its bitrate and its stalls. Seeks rebuffer on purpose and
+    // are not counted.
+    NetworkCachingPolicy m_cachingPolicy;
+    QElapsedTimer m_openClock;       // valid while a fresh open is measured
+    qint64 m_connectMs = -1;         // open to first buffered data
+    bool m_stalled = false;
+    bool m_seekPending = false;      // the next buffering comes from a seek
+    int m_rebuffers = 0;             // stalls since loadMedia
+    qint64 m_startupMs = -1;         // loadMedia to Playing, -1 until known
+    libvlc_media_t* m_statsMedia = nullptr;
+    qint64 m_readBytes = 0;          // input bytes at the previous sample
+    qint64 m_sampledTime = 0;        // m_time at the previous sample
+    int m_stillSamples = 0;          // samples in a row without progress
+    QVariantMap m_streamStats;       // libvlc_media_get_stats, see streamStats
+    // Per-session QoE record (AppDataLocation/sessions.log).
+    SessionLog m_sessionLog;
+
+    // Position and length from libVLC's TimeChanged / LengthChanged events.
+    // The event thread only stores the newest time; the GUI thread picks it
+    // up at most once per display refresh (m_positionThrottle), and nothing
+    // runs while paused.
+    qint64 m_time = 0;
+    qint64 m_length = 0;
+    std::atomic<qint64> m_pendingTime{ 0 };
+    std::atomic<bool> m_timeUpdatePending{ false };
+    QTimer* m_positionThrottle;
+
+    // Seeks requested faster than VLC can serve them (skip keys, scrubbing)
+    // collapse into one target, sent when m_seekTimer runs out. Until VLC
+    // reports a time near the target, stale TimeChanged values are ignored
+    // so the position doesn't jump back.
+    QTimer* m_seekTimer;
+    qint64 m_seekTarget = -1;        // ms, -1 when no seek is in progress
+    bool m_seekFast = true;          // every merged request allowed keyframe seeking
+    QElapsedTimer m_seekClock;       // since the target was sent to VLC
+
+    // Next episode opened paused on a standby player during the last
+    // minutes of this one, so loadMedia() can switch to an already
+    // connected, probed stream.
+    QString m_nextMediaId;
+    QString m_prerollMediaId;
+    libvlc_media_player_t* m_prerollPlayer = nullptr;
+    libvlc_media_t* m_prerollMedia = nullptr;
+    int m_volume = -1;  // last setVolume(), reapplied after a swap
 
     // Track lists
     QVariantList m_subtitleTracks;
@@ -262,7 +542,13 @@ private:
 
     // Network handling
     QNetworkAccessManager m_networkManager;
-    int m_pendingSubtitles;
+    int m_pendingSubtitles;            // subtitle probes in flight
+    ProgressJournal m_progressJournal; // durable outbox for watch progress
+    bool m_headless = false;           // Mode::Headless: no journal, proxy or conf.ini
+    // Loopback proxy with an on-disk range cache that VLC streams through
+    // (conf.ini streamCacheMB, default 4096; 0 streams from the server directly).
+    StreamProxy m_streamProxy;
+    QStringList m_subtitleLanguages;   // conf.ini subtitleLanguages, e.g. "es,en"
 
     // Playback progress tracking
     double last_percentage_watched;
@@ -270,25 +556,69 @@ private:
     // Fullscreen state (controls QML layout via fullScreenChanged signal)
     bool fullScreen;
 
-    // Frame buffer shared between VLC's video thread and the GUI thread.
-    // m_frameMutex is held during VLC lock/unlock and during GUI-side reads,
-    // which means VLC will block on its next lock if delivery is slow.
-    QMutex m_frameMutex;
+    // Audio-only mode. Read on VLC's video thread when the output closes.
+    std::atomic<bool> m_audioOnly{ false };
+    bool m_mediaAudioOnly = false;  // current media was opened with :no-video
+    int m_videoTrackId = -1;        // video ES to select again when leaving the mode
+
+    // Negotiated video geometry. Only touched on VLC's video output thread.
     int m_videoWidth;        // visible frame width in pixels
     int m_videoHeight;       // visible frame height in pixels
-    // I420 / YUV420P planes. Each plane is allocated to aligned dimensions
-    // (rounded up to 32 px) so VLC's video pipeline has room to write its
-    // padded output without scribbling past the buffer.
-    uchar* m_planeY;
-    uchar* m_planeU;
-    uchar* m_planeV;
+    int m_bitDepth;          // 8 (I420) or 10 (I0AL)
+    // YUV → RGB conversion for the negotiated format, applied on both the
+    // CPU and the GPU path.
+    YuvConverter::ColorMatrix m_colorMatrix;
+    YuvConverter::ColorRange m_colorRange;
+    // I420 / YUV420P plane geometry. Each plane is sized to aligned
+    // dimensions (width to 64 px, height to 32 px) so VLC's video pipeline has
+    // room to write its padded output without scribbling past the buffer.
     int m_pitchY;
     int m_pitchU;
     int m_pitchV;
     int m_linesY;
     int m_linesU;
     int m_linesV;
-    bool m_frameDeliveryPending;
+    // Every picture allocated for the current format (video thread only).
+    // Planar frames wrap the same memory for the sink, so a picture is only
+    // reused once nothing but this list references it.
+    std::vector<std::shared_ptr<VideoPicture>> m_pictures;
+    // Full-size planes VLC decodes into when no picture can be allocated;
+    // never published, so those frames are dropped (video thread only).
+    std::shared_ptr<VideoPicture> m_scratchPicture;
+    // Aligned plane memory behind m_pictures. Outlives format changes and
+    // loadMedia calls so episode switches reuse the same buffers.
+    std::shared_ptr<FrameBufferPool> m_bufferPool;
+
+    // Frame hand-off between VLC's video thread (producer) and the GUI
+    // thread (consumer). No lock: VLC always writes into a free slot and
+    // deliverFrame always reads the newest completed one.
+    TripleBuffer<std::shared_ptr<VideoPicture>> m_frames;
+    // Turns published frames into deliverFrame calls aligned to the video
+    // window's vsync, and measures how evenly they reach the screen.
+    FramePacer m_framePacer;
+    // Seek-bar previews, built on a second libVLC player a little after
+    // playback starts and paused while the main stream stalls.
+    ThumbnailExtractor m_thumbnails;
+    // Lock, latency and conversion timings; sampled by m_statsTimer.
+    FrameStats m_frameStats;
+    QVariantMap m_frameStatsSample;
+    QElapsedTimer m_statsClock;
+    int m_statsTicks = 0;
+    // Chosen in videoFormatCallback: true hands Format_YUV420P frames to the
+    // sink (GPU conversion), false converts to BGRA on the CPU.
+    std::atomic<bool> m_planarOutput{ false };
+    // Splits the CPU BGRA conversion of large frames across cores.
+    FrameSlicer m_frameSlicer;
+    // Video item and its size in physical pixels (GUI thread). An empty size
+    // means unknown, and frames are delivered at full resolution.
+    QPointer<QQuickItem> m_videoOutput;
+    QSize m_outputSize;
+    // Taps for the current source → delivery size, rebuilt when either
+    // changes (GUI thread).
+    YuvConverter::ScaleFilter m_scaleFilter;
+    // Transfer assumed for 10-bit video (conf.ini hdrToneMapping=pq|hlg).
+    // libVLC 3 doesn't report it, so by default 10-bit is treated as SDR.
+    YuvConverter::ToneMap m_toneMap;
 
     // Idle-inhibitor state. On Linux this is the cookie returned by
     // org.freedesktop.ScreenSaver.Inhibit (0 = not held). On Windows we just
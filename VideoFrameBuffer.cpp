@@ -0,0 +1,100 @@
+#include "VideoFrameBuffer.h"
+
+VideoPicture::~VideoPicture() {
+    const std::shared_ptr<FrameBufferPool> owner = pool.lock();
+    for (int i = 0; i < 3; ++i) {
+        if (!planes[i]) continue;
+        if (owner) {
+            owner->release(planes[i], pitches[i], lines[i]);
+        } else {
+            FrameBufferPool::freeAligned(planes[i]);
+        }
+    }
+}
+
+std::shared_ptr<VideoPicture> VideoPicture::create(const std::shared_ptr<FrameBufferPool>& pool,
+                                                   int width, int height,
+                                                   const int pitches[3], const int lines[3],
+                                                   int bitDepth) {
+    auto picture = std::make_shared<VideoPicture>();
+    picture->width = width;
+    picture->height = height;
+    picture->bitDepth = bitDepth;
+    picture->pool = pool;
+    for (int i = 0; i < 3; ++i) {
+        picture->pitches[i] = pitches[i];
+        picture->lines[i] = lines[i];
+        picture->planes[i] = pool->acquire(pitches[i], lines[i]);
+        if (!picture->planes[i]) return nullptr;
+    }
+    return picture;
+}
+
+bool VideoPicture::matches(int w, int h, const int p[3], const int l[3]) const {
+    if (width != w || height != h) return false;
+    for (int i = 0; i < 3; ++i) {
+        if (pitches[i] != p[i] || lines[i] != l[i]) return false;
+    }
+    return true;
+}
+
+VideoFrameBuffer::VideoFrameBuffer(std::shared_ptr<VideoPicture> picture,
+                                   QVideoFrameFormat::ColorTransfer transfer)
+    : m_picture(std::move(picture))
+    , m_transfer(transfer)
+{
+    if (m_picture)
+        m_picture->frameRefs.fetch_add(1, std::memory_order_relaxed);
+}
+
+VideoFrameBuffer::~VideoFrameBuffer() {
+    if (m_picture)
+        m_picture->frameRefs.fetch_sub(1, std::memory_order_release);
+}
+
+QAbstractVideoBuffer::MapData VideoFrameBuffer::map(QVideoFrame::MapMode /*mode*/) {
+    MapData data;
+    if (!m_picture) return data;
+
+    // Qt reads only the visible rows; the padding VLC asked for stays unused.
+    const int rows[3] = { m_picture->height, (m_picture->height + 1) / 2, (m_picture->height + 1) / 2 };
+    data.planeCount = 3;
+    for (int i = 0; i < 3; ++i) {
+        data.data[i] = m_picture->planes[i];
+        data.bytesPerLine[i] = m_picture->pitches[i];
+        data.dataSize[i] = m_picture->pitches[i] * rows[i];
+    }
+    return data;
+}
+
+QVideoFrameFormat VideoFrameBuffer::format() const {
+    if (!m_picture) return QVideoFrameFormat();
+    const bool highBitDepth = m_picture->bitDepth > 8;
+    QVideoFrameFormat format(QSize(m_picture->width, m_picture->height),
+                             highBitDepth ? QVideoFrameFormat::Format_YUV420P10
+                                          : QVideoFrameFormat::Format_YUV420P);
+    // Same matrix and range the CPU path would use, so both paths agree.
+    switch (m_picture->matrix) {
+    case YuvConverter::ColorMatrix::Bt709:
+        format.setColorSpace(QVideoFrameFormat::ColorSpace_BT709);
+        break;
+    case YuvConverter::ColorMatrix::Bt2020:
+        format.setColorSpace(QVideoFrameFormat::ColorSpace_BT2020);
+        break;
+    default:
+        format.setColorSpace(QVideoFrameFormat::ColorSpace_BT601);
+        break;
+    }
+    format.setColorRange(m_picture->range == YuvConverter::ColorRange::Full
+                             ? QVideoFrameFormat::ColorRange_Full
+                             : QVideoFrameFormat::ColorRange_Video);
+    if (highBitDepth && (m_transfer == QVideoFrameFormat::ColorTransfer_ST2084 ||
+                         m_transfer == QVideoFrameFormat::ColorTransfer_STD_B67)) {
+        // HDR10 and HLG are mastered in BT.2020; 1000 cd/m² is the usual
+        // mastering peak when the stream doesn't say otherwise.
+        format.setColorSpace(QVideoFrameFormat::ColorSpace_BT2020);
+        format.setColorTransfer(m_transfer);
+        format.setMaxLuminance(1000.0f);
+    }
+    return format;
+}
@@ -0,0 +1,77 @@
+#ifndef VIDEOFRAMEBUFFER_H
+#define VIDEOFRAMEBUFFER_H
+
+#include <QAbstractVideoBuffer>
+#include <QVideoFrameFormat>
+#include <atomic>
+#include <memory>
+#include "FrameBufferPool.h"
+#include "YuvConverter.h"
+
+/**
+ * @brief One decoded I420 or I0AL picture that libVLC writes into directly
+ *
+ * Pictures are shared between VLC's video output thread (which decodes into
+ * them), the GUI thread and Qt's render thread (which sample them through a
+ * VideoFrameBuffer). A picture is only handed back to VLC once no QVideoFrame
+ * references it any more.
+ */
+struct VideoPicture {
+    uchar* planes[3] = { nullptr, nullptr, nullptr };
+    int pitches[3] = { 0, 0, 0 };
+    int lines[3] = { 0, 0, 0 };
+    int width = 0;   // visible width in pixels
+    int height = 0;  // visible height in pixels
+    int bitDepth = 8;  // 8 for I420, 10 for I0AL (16-bit little-endian samples)
+    YuvConverter::ColorMatrix matrix = YuvConverter::ColorMatrix::Bt601;
+    YuvConverter::ColorRange range = YuvConverter::ColorRange::Limited;
+    // FramePacer::now() when VLC asked for the picture to be shown
+    qint64 presentationTime = 0;
+    // Planes go back here on destruction; freed directly if the pool is gone.
+    std::weak_ptr<FrameBufferPool> pool;
+    // VideoFrameBuffers wrapping the picture. Dropped with release ordering
+    // once the render thread is done with the planes, and read with acquire
+    // ordering before VLC decodes into them again.
+    std::atomic<int> frameRefs{ 0 };
+
+    VideoPicture() = default;
+    VideoPicture(const VideoPicture&) = delete;
+    VideoPicture& operator=(const VideoPicture&) = delete;
+    ~VideoPicture();
+
+    /**
+     * @brief Takes aligned planes for the given geometry from a pool
+     * @return The picture, or nullptr if an allocation failed
+     */
+    static std::shared_ptr<VideoPicture> create(const std::shared_ptr<FrameBufferPool>& pool,
+                                                int width, int height,
+                                                const int pitches[3], const int lines[3],
+                                                int bitDepth = 8);
+
+    /** @brief True if the picture was allocated for exactly this geometry */
+    bool matches(int width, int height, const int pitches[3], const int lines[3]) const;
+};
+
+/**
+ * @brief QAbstractVideoBuffer that exposes a VideoPicture to Qt without copying
+ *
+ * The buffer keeps the picture alive for as long as Qt holds the frame, so
+ * the planes VLC decoded into are uploaded straight to the GPU. 10-bit
+ * pictures are exposed as Format_YUV420P10; tagging them with an HDR
+ * transfer lets Qt's shader tone-map them for SDR outputs.
+ */
+class VideoFrameBuffer : public QAbstractVideoBuffer {
+public:
+    explicit VideoFrameBuffer(std::shared_ptr<VideoPicture> picture,
+                              QVideoFrameFormat::ColorTransfer transfer = QVideoFrameFormat::ColorTransfer_Unknown);
+    ~VideoFrameBuffer() override;
+
+    MapData map(QVideoFrame::MapMode mode) override;
+    QVideoFrameFormat format() const override;
+
+private:
+    std::shared_ptr<VideoPicture> m_picture;
+    QVideoFrameFormat::ColorTransfer m_transfer;
+};
+
+#endif // VIDEOFRAMEBUFFER_H
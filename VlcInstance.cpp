@@ -0,0 +1,71 @@
+#include "VlcInstance.h"
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+
+namespace {
+std::once_flag s_created;
+libvlc_instance_t* s_instance = nullptr;  // the process's own reference
+
+/**
+ * @brief Callback function for VLC logging system
+ * @param data User data pointer passed to the callback
+ * @param level Severity level of the log message
+ * @param ctx VLC log context
+ * @param fmt Format string for the log message
+ * @param args Variable argument list containing log message parameters
+ */
+void vlcLogCallback(void* data, int level, const libvlc_log_t* ctx, const char* fmt, va_list args) {
+    // libVLC levels: 0=DEBUG, 2=NOTICE, 3=WARNING, 4=ERROR.
+    // Skip everything below WARNING so our [GHOST] lines aren't lost in noise.
+    if (level < 3) return;
+    char buf[1024];
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    fprintf(stderr, "[VLC log level=%d] %s\n", level, buf);
+    fflush(stderr);
+}
+}
+
+void VlcInstance::warmUp() {
+    QThreadPool::globalInstance()->start([]() { std::call_once(s_created, &VlcInstance::create); });
+}
+
+libvlc_instance_t* VlcInstance::acquire() {
+    // Waits here if warmUp() got there first and is still loading plugins.
+    std::call_once(s_created, &VlcInstance::create);
+    if (!s_instance)
+        return nullptr;
+    libvlc_retain(s_instance);
+    return s_instance;
+}
+
+void VlcInstance::shutdown() {
+    std::call_once(s_created, []() {});  // nothing to release if never created
+    if (s_instance) {
+        libvlc_release(s_instance);
+        s_instance = nullptr;
+    }
+}
+
+void VlcInstance::create() {
+    // VLC command line arguments
+    const char* args[] = {
+        "--quiet",
+    };
+
+    QElapsedTimer clock;
+    clock.start();
+    fprintf(stderr, "[GHOST] Calling libvlc_new...\n"); fflush(stderr);
+    s_instance = libvlc_new(sizeof(args) / sizeof(*args), args);
+    fprintf(stderr, "[GHOST] libvlc_new returned: %p after %lld ms\n", (void*)s_instance,
+            static_cast<long long>(clock.elapsed()));
+    fflush(stderr);
+    if (!s_instance) {
+        fprintf(stderr, "[GHOST] ERROR: Failed to create VLC instance\n"); fflush(stderr);
+        return;
+    }
+    libvlc_set_log_verbosity(s_instance, 2);
+    libvlc_log_set(s_instance, vlcLogCallback, nullptr);
+}
@@ -0,0 +1,36 @@
+#ifndef VLCINSTANCE_H
+#define VLCINSTANCE_H
+
+#include <vlc/vlc.h>
+
+/**
+ * @brief The process-wide libVLC instance
+ *
+ * libvlc_new loads and scans the whole plugin set, which takes hundreds of
+ * milliseconds. It is done once per process, ideally on a background thread
+ * while the UI starts (warmUp()); players then only create
+ * libvlc_media_player_t objects from it. The instance is reference counted
+ * through libVLC itself: acquire() returns a retained pointer that the
+ * caller gives back with libvlc_release().
+ */
+class VlcInstance {
+public:
+    /** @brief Starts creating the instance on a pool thread, if not done yet */
+    static void warmUp();
+
+    /**
+     * @brief Returns the shared instance, retained for the caller
+     *
+     * Blocks while warmUp() is still creating it.
+     * @return nullptr if libVLC could not be initialized
+     */
+    static libvlc_instance_t* acquire();
+
+    /** @brief Drops the process's own reference; call once, after the last player is gone */
+    static void shutdown();
+
+private:
+    static void create();
+};
+
+#endif // VLCINSTANCE_H
@@ -0,0 +1,1332 @@
+#include "YuvConverter.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define YUV_ARCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+#define YUV_ARCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC/Clang only emit AVX2 instructions inside functions that opt in; MSVC
+// allows any intrinsic anywhere, so the attributes expand to nothing there.
+#if defined(YUV_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define YUV_TARGET_SSE2 __attribute__((target("sse2")))
+#define YUV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define YUV_TARGET_SSE2
+#define YUV_TARGET_AVX2
+#endif
+
+namespace YuvConverter {
+
+namespace {
+
+// YUV → RGB coefficients in 10-bit fixed point. Every kernel below
+// evaluates exactly ((Y - yOffset) * y + cU * U + cV * V + 512) >> 10 in
+// 32-bit integers and clamps to [0, 255], so the SIMD paths match the scalar
+// reference bit for bit. All values fit the int16 lanes pmaddwd needs.
+constexpr int kRound = 1 << 9;
+
+struct Coefficients {
+    int y;
+    int rv;
+    int gu;
+    int gv;
+    int bu;
+    int yOffset;
+};
+
+constexpr int toFixed(double v) {
+    return static_cast<int>(v >= 0.0 ? v * 1024.0 + 0.5 : v * 1024.0 - 0.5);
+}
+
+// Derived from the matrix's luma weights Kr and Kb; limited range also
+// stretches Y from 219 and chroma from 224 steps up to 255.
+constexpr Coefficients makeCoefficients(double kr, double kb, ColorRange range) {
+    const double kg = 1.0 - kr - kb;
+    const double ys = range == ColorRange::Limited ? 255.0 / 219.0 : 1.0;
+    const double cs = range == ColorRange::Limited ? 255.0 / 224.0 : 1.0;
+    return {
+        toFixed(ys),
+        toFixed(2.0 * (1.0 - kr) * cs),
+        toFixed(-2.0 * (1.0 - kb) * kb / kg * cs),
+        toFixed(-2.0 * (1.0 - kr) * kr / kg * cs),
+        toFixed(2.0 * (1.0 - kb) * cs),
+        range == ColorRange::Limited ? 16 : 0,
+    };
+}
+
+template <ColorMatrix M, ColorRange R>
+constexpr Coefficients coefficients() {
+    if constexpr (M == ColorMatrix::Bt709) return makeCoefficients(0.2126, 0.0722, R);
+    else if constexpr (M == ColorMatrix::Bt2020) return makeCoefficients(0.2627, 0.0593, R);
+    else return makeCoefficients(0.299, 0.114, R);
+}
+
+/**
+ * @brief Reference per-pixel conversion for one row, starting at column x
+ */
+template <ColorMatrix M, ColorRange R>
+void convertRowScalar(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                      uint8_t* dstRow, int x, int width) {
+    constexpr Coefficients c = coefficients<M, R>();
+    for (; x < width; ++x) {
+        const int Y = yRow[x] - c.yOffset;
+        const int U = uRow[x / 2] - 128;
+        const int V = vRow[x / 2] - 128;
+
+        int r = Y * c.y + c.rv * V + kRound;
+        int g = Y * c.y + c.gu * U + c.gv * V + kRound;
+        int b = Y * c.y + c.bu * U + kRound;
+
+        r = std::clamp(r >> 10, 0, 255);
+        g = std::clamp(g >> 10, 0, 255);
+        b = std::clamp(b >> 10, 0, 255);
+
+        uint8_t* px = dstRow + x * 4;
+        px[0] = static_cast<uint8_t>(b);
+        px[1] = static_cast<uint8_t>(g);
+        px[2] = static_cast<uint8_t>(r);
+        px[3] = 0xFF;
+    }
+}
+
+/**
+ * @brief Reference 10 → 8-bit narrowing, starting at index x
+ */
+void narrowScalar(const uint16_t* src, uint8_t* dst, int x, int count) {
+    for (; x < count; ++x) {
+        dst[x] = static_cast<uint8_t>(std::min((src[x] + 2) >> 2, 255));
+    }
+}
+
+#if defined(YUV_ARCH_X86)
+
+// ---------------------------------------------------------------------------
+// SSE2: 16 pixels per iteration. pmaddwd multiplies interleaved (luma, chroma)
+// 16-bit pairs by (y, coefficient) pairs and sums them into 32 bits, which
+// gives the exact same integer as the scalar expression.
+// ---------------------------------------------------------------------------
+
+YUV_TARGET_SSE2 inline __m128i pairCoefSse2(int a, int b) {
+    return _mm_setr_epi16(static_cast<short>(a), static_cast<short>(b),
+                          static_cast<short>(a), static_cast<short>(b),
+                          static_cast<short>(a), static_cast<short>(b),
+                          static_cast<short>(a), static_cast<short>(b));
+}
+
+// (a * coef.lo + b * coef.hi + 512) >> 10 for 8 lanes, saturated to int16.
+YUV_TARGET_SSE2 inline __m128i maddShiftSse2(__m128i a, __m128i b, __m128i coef) {
+    const __m128i round = _mm_set1_epi32(kRound);
+    const __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), coef), round), 10);
+    const __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), coef), round), 10);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// Green needs three terms: (Y * y + U * gu) + (V * gv + 1 * 512), so the
+// rounding constant rides along in the second pmaddwd for free.
+YUV_TARGET_SSE2 inline __m128i greenSse2(__m128i y, __m128i u, __m128i v,
+                                         __m128i coefYU, __m128i coefV) {
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i lo = _mm_srai_epi32(
+        _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, u), coefYU),
+                      _mm_madd_epi16(_mm_unpacklo_epi16(v, one), coefV)), 10);
+    const __m128i hi = _mm_srai_epi32(
+        _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, u), coefYU),
+                      _mm_madd_epi16(_mm_unpackhi_epi16(v, one), coefV)), 10);
+    return _mm_packs_epi32(lo, hi);
+}
+
+template <bool Aligned>
+YUV_TARGET_SSE2 inline __m128i loadSse2(const uint8_t* p) {
+    return Aligned ? _mm_load_si128(reinterpret_cast<const __m128i*>(p))
+                   : _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+template <ColorMatrix M, ColorRange R, bool Aligned>
+YUV_TARGET_SSE2 void convertRowSse2Impl(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                                        uint8_t* dstRow, int width) {
+    constexpr Coefficients c = coefficients<M, R>();
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i yOffset = _mm_set1_epi16(c.yOffset);
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i coefR = pairCoefSse2(c.y, c.rv);
+    const __m128i coefB = pairCoefSse2(c.y, c.bu);
+    const __m128i coefG = pairCoefSse2(c.y, c.gu);
+    const __m128i coefGV = pairCoefSse2(c.gv, kRound);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i y8 = loadSse2<Aligned>(yRow + x);
+        __m128i u8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(uRow + x / 2));
+        __m128i v8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(vRow + x / 2));
+        // Each chroma sample covers two horizontal pixels.
+        u8 = _mm_unpacklo_epi8(u8, u8);
+        v8 = _mm_unpacklo_epi8(v8, v8);
+
+        __m128i yLo = _mm_unpacklo_epi8(y8, zero);
+        __m128i yHi = _mm_unpackhi_epi8(y8, zero);
+        if constexpr (R == ColorRange::Limited) {
+            yLo = _mm_sub_epi16(yLo, yOffset);
+            yHi = _mm_sub_epi16(yHi, yOffset);
+        }
+        const __m128i uLo = _mm_sub_epi16(_mm_unpacklo_epi8(u8, zero), bias);
+        const __m128i uHi = _mm_sub_epi16(_mm_unpackhi_epi8(u8, zero), bias);
+        const __m128i vLo = _mm_sub_epi16(_mm_unpacklo_epi8(v8, zero), bias);
+        const __m128i vHi = _mm_sub_epi16(_mm_unpackhi_epi8(v8, zero), bias);
+
+        // packus clamps to [0, 255] exactly like std::clamp in the scalar path.
+        const __m128i r = _mm_packus_epi16(maddShiftSse2(yLo, vLo, coefR),
+                                           maddShiftSse2(yHi, vHi, coefR));
+        const __m128i g = _mm_packus_epi16(greenSse2(yLo, uLo, vLo, coefG, coefGV),
+                                           greenSse2(yHi, uHi, vHi, coefG, coefGV));
+        const __m128i b = _mm_packus_epi16(maddShiftSse2(yLo, uLo, coefB),
+                                           maddShiftSse2(yHi, uHi, coefB));
+
+        const __m128i bgLo = _mm_unpacklo_epi8(b, g);
+        const __m128i bgHi = _mm_unpackhi_epi8(b, g);
+        const __m128i raLo = _mm_unpacklo_epi8(r, alpha);
+        const __m128i raHi = _mm_unpackhi_epi8(r, alpha);
+
+        __m128i* out = reinterpret_cast<__m128i*>(dstRow + x * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bgLo, raLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bgLo, raLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bgHi, raHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bgHi, raHi));
+    }
+    convertRowScalar<M, R>(yRow, uRow, vRow, dstRow, x, width);
+}
+
+inline bool isAligned(const void* p, uintptr_t alignment) {
+    return (reinterpret_cast<uintptr_t>(p) & (alignment - 1)) == 0;
+}
+
+// Rows from the frame buffer pool start on 64-byte boundaries with pitches
+// that keep them there, so the aligned variant is the one normally taken.
+template <ColorMatrix M, ColorRange R>
+YUV_TARGET_SSE2 void convertRowSse2(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                                    uint8_t* dstRow, int width) {
+    if (isAligned(yRow, 16)) {
+        convertRowSse2Impl<M, R, true>(yRow, uRow, vRow, dstRow, width);
+    } else {
+        convertRowSse2Impl<M, R, false>(yRow, uRow, vRow, dstRow, width);
+    }
+}
+
+// Saturating add keeps (s + 2) from wrapping; packus then clamps to 255.
+YUV_TARGET_SSE2 void narrowSse2(const uint16_t* src, uint8_t* dst, int count) {
+    const __m128i round = _mm_set1_epi16(2);
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x + 8));
+        const __m128i a = _mm_srli_epi16(_mm_adds_epu16(lo, round), 2);
+        const __m128i b = _mm_srli_epi16(_mm_adds_epu16(hi, round), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(a, b));
+    }
+    narrowScalar(src, dst, x, count);
+}
+
+// ---------------------------------------------------------------------------
+// AVX2: 32 pixels per iteration. AVX2 unpack/pack work within 128-bit lanes,
+// so chroma is widened with vpmovzxbw (lane-crossing) and the final byte
+// packs are re-ordered with vpermq before the BGRA interleave.
+// ---------------------------------------------------------------------------
+
+YUV_TARGET_AVX2 inline __m256i pairCoefAvx2(int a, int b) {
+    return _mm256_set1_epi32(static_cast<int>((static_cast<uint32_t>(b) << 16) |
+                                              (static_cast<uint32_t>(a) & 0xFFFFu)));
+}
+
+YUV_TARGET_AVX2 inline __m256i maddShiftAvx2(__m256i a, __m256i b, __m256i coef) {
+    const __m256i round = _mm256_set1_epi32(kRound);
+    const __m256i lo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), coef), round), 10);
+    const __m256i hi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), coef), round), 10);
+    // unpack and pack are both in-lane, so the pixel order is restored here.
+    return _mm256_packs_epi32(lo, hi);
+}
+
+YUV_TARGET_AVX2 inline __m256i greenAvx2(__m256i y, __m256i u, __m256i v,
+                                         __m256i coefYU, __m256i coefV) {
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i lo = _mm256_srai_epi32(
+        _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(y, u), coefYU),
+                         _mm256_madd_epi16(_mm256_unpacklo_epi16(v, one), coefV)), 10);
+    const __m256i hi = _mm256_srai_epi32(
+        _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(y, u), coefYU),
+                         _mm256_madd_epi16(_mm256_unpackhi_epi16(v, one), coefV)), 10);
+    return _mm256_packs_epi32(lo, hi);
+}
+
+// Packs two runs of 16 int16 values into 32 ordered bytes.
+YUV_TARGET_AVX2 inline __m256i packOrderedAvx2(__m256i a, __m256i b) {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+}
+
+template <ColorMatrix M, ColorRange R, bool Aligned>
+YUV_TARGET_AVX2 void convertRowAvx2Impl(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                                        uint8_t* dstRow, int width) {
+    constexpr Coefficients c = coefficients<M, R>();
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i yOffset = _mm256_set1_epi16(c.yOffset);
+    const __m256i alpha = _mm256_set1_epi8(static_cast<char>(0xFF));
+    const __m256i coefR = pairCoefAvx2(c.y, c.rv);
+    const __m256i coefB = pairCoefAvx2(c.y, c.bu);
+    const __m256i coefG = pairCoefAvx2(c.y, c.gu);
+    const __m256i coefGV = pairCoefAvx2(c.gv, kRound);
+
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i y8 = Aligned ? _mm256_load_si256(reinterpret_cast<const __m256i*>(yRow + x))
+                                   : _mm256_loadu_si256(reinterpret_cast<const __m256i*>(yRow + x));
+        const __m128i u8 = Aligned ? _mm_load_si128(reinterpret_cast<const __m128i*>(uRow + x / 2))
+                                   : _mm_loadu_si128(reinterpret_cast<const __m128i*>(uRow + x / 2));
+        const __m128i v8 = Aligned ? _mm_load_si128(reinterpret_cast<const __m128i*>(vRow + x / 2))
+                                   : _mm_loadu_si128(reinterpret_cast<const __m128i*>(vRow + x / 2));
+
+        __m256i yA = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(y8));
+        __m256i yB = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(y8, 1));
+        if constexpr (R == ColorRange::Limited) {
+            yA = _mm256_sub_epi16(yA, yOffset);
+            yB = _mm256_sub_epi16(yB, yOffset);
+        }
+        const __m256i uA = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8)), bias);
+        const __m256i uB = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpackhi_epi8(u8, u8)), bias);
+        const __m256i vA = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8)), bias);
+        const __m256i vB = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_unpackhi_epi8(v8, v8)), bias);
+
+        const __m256i r = packOrderedAvx2(maddShiftAvx2(yA, vA, coefR),
+                                          maddShiftAvx2(yB, vB, coefR));
+        const __m256i g = packOrderedAvx2(greenAvx2(yA, uA, vA, coefG, coefGV),
+                                          greenAvx2(yB, uB, vB, coefG, coefGV));
+        const __m256i b = packOrderedAvx2(maddShiftAvx2(yA, uA, coefB),
+                                          maddShiftAvx2(yB, uB, coefB));
+
+        // Lane 0 holds pixels 0-7 / 8-15, lane 1 holds 16-23 / 24-31.
+        const __m256i bgLo = _mm256_unpacklo_epi8(b, g);
+        const __m256i bgHi = _mm256_unpackhi_epi8(b, g);
+        const __m256i raLo = _mm256_unpacklo_epi8(r, alpha);
+        const __m256i raHi = _mm256_unpackhi_epi8(r, alpha);
+        const __m256i p0 = _mm256_unpacklo_epi16(bgLo, raLo); // 0-3   | 16-19
+        const __m256i p1 = _mm256_unpackhi_epi16(bgLo, raLo); // 4-7   | 20-23
+        const __m256i p2 = _mm256_unpacklo_epi16(bgHi, raHi); // 8-11  | 24-27
+        const __m256i p3 = _mm256_unpackhi_epi16(bgHi, raHi); // 12-15 | 28-31
+
+        __m256i* out = reinterpret_cast<__m256i*>(dstRow + x * 4);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+    // Finish with SSE2 for a remaining 16-pixel block, then scalar.
+    if (x < width) {
+        convertRowSse2<M, R>(yRow + x, uRow + x / 2, vRow + x / 2, dstRow + x * 4, width - x);
+    }
+}
+
+template <ColorMatrix M, ColorRange R>
+YUV_TARGET_AVX2 void convertRowAvx2(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                                    uint8_t* dstRow, int width) {
+    if (isAligned(yRow, 32) && isAligned(uRow, 16) && isAligned(vRow, 16)) {
+        convertRowAvx2Impl<M, R, true>(yRow, uRow, vRow, dstRow, width);
+    } else {
+        convertRowAvx2Impl<M, R, false>(yRow, uRow, vRow, dstRow, width);
+    }
+}
+
+YUV_TARGET_AVX2 void narrowAvx2(const uint16_t* src, uint8_t* dst, int count) {
+    const __m256i round = _mm256_set1_epi16(2);
+    int x = 0;
+    for (; x + 32 <= count; x += 32) {
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x + 16));
+        const __m256i a = _mm256_srli_epi16(_mm256_adds_epu16(lo, round), 2);
+        const __m256i b = _mm256_srli_epi16(_mm256_adds_epu16(hi, round), 2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), packOrderedAvx2(a, b));
+    }
+    if (x < count) {
+        narrowSse2(src + x, dst + x, count - x);
+    }
+}
+
+bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+    // The OS must save the YMM state on context switches.
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpuHasSse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    int info[4] = {};
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif // YUV_ARCH_X86
+
+#if defined(YUV_ARCH_NEON)
+
+// ---------------------------------------------------------------------------
+// NEON: 16 pixels per iteration using widening multiply-accumulate. vrshr
+// adds the same 512 before shifting, and vqmovn / vqmovun provide the same
+// saturation as the scalar clamp.
+// ---------------------------------------------------------------------------
+
+inline int16x8_t maddShiftNeon(int16x8_t a, int16_t ca, int16x8_t b, int16_t cb) {
+    int32x4_t lo = vmull_n_s16(vget_low_s16(a), ca);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(a), ca);
+    lo = vmlal_n_s16(lo, vget_low_s16(b), cb);
+    hi = vmlal_n_s16(hi, vget_high_s16(b), cb);
+    return vcombine_s16(vqmovn_s32(vrshrq_n_s32(lo, 10)), vqmovn_s32(vrshrq_n_s32(hi, 10)));
+}
+
+inline int16x8_t greenNeon(int16x8_t y, int16_t cy, int16x8_t u, int16_t cu, int16x8_t v, int16_t cv) {
+    int32x4_t lo = vmull_n_s16(vget_low_s16(y), cy);
+    int32x4_t hi = vmull_n_s16(vget_high_s16(y), cy);
+    lo = vmlal_n_s16(lo, vget_low_s16(u), cu);
+    hi = vmlal_n_s16(hi, vget_high_s16(u), cu);
+    lo = vmlal_n_s16(lo, vget_low_s16(v), cv);
+    hi = vmlal_n_s16(hi, vget_high_s16(v), cv);
+    return vcombine_s16(vqmovn_s32(vrshrq_n_s32(lo, 10)), vqmovn_s32(vrshrq_n_s32(hi, 10)));
+}
+
+template <ColorMatrix M, ColorRange R>
+void convertRowNeon(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                    uint8_t* dstRow, int width) {
+    constexpr Coefficients c = coefficients<M, R>();
+    const int16x8_t bias = vdupq_n_s16(128);
+    const int16x8_t yOffset = vdupq_n_s16(c.yOffset);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const uint8x16_t y8 = vld1q_u8(yRow + x);
+        const uint8x8_t u8 = vld1_u8(uRow + x / 2);
+        const uint8x8_t v8 = vld1_u8(vRow + x / 2);
+        const uint8x8x2_t uu = vzip_u8(u8, u8);
+        const uint8x8x2_t vv = vzip_u8(v8, v8);
+
+        int16x8_t yLo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y8)));
+        int16x8_t yHi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y8)));
+        if constexpr (R == ColorRange::Limited) {
+            yLo = vsubq_s16(yLo, yOffset);
+            yHi = vsubq_s16(yHi, yOffset);
+        }
+        const int16x8_t uLo = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uu.val[0])), bias);
+        const int16x8_t uHi = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uu.val[1])), bias);
+        const int16x8_t vLo = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vv.val[0])), bias);
+        const int16x8_t vHi = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vv.val[1])), bias);
+
+        uint8x16x4_t px;
+        px.val[0] = vcombine_u8(vqmovun_s16(maddShiftNeon(yLo, c.y, uLo, c.bu)),
+                                vqmovun_s16(maddShiftNeon(yHi, c.y, uHi, c.bu)));
+        px.val[1] = vcombine_u8(vqmovun_s16(greenNeon(yLo, c.y, uLo, c.gu, vLo, c.gv)),
+                                vqmovun_s16(greenNeon(yHi, c.y, uHi, c.gu, vHi, c.gv)));
+        px.val[2] = vcombine_u8(vqmovun_s16(maddShiftNeon(yLo, c.y, vLo, c.rv)),
+                                vqmovun_s16(maddShiftNeon(yHi, c.y, vHi, c.rv)));
+        px.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dstRow + x * 4, px);
+    }
+    convertRowScalar<M, R>(yRow, uRow, vRow, dstRow, x, width);
+}
+
+// vqrshrn rounds and saturates in one step: exactly min((s + 2) >> 2, 255).
+void narrowNeon(const uint16_t* src, uint8_t* dst, int count) {
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        const uint8x8_t lo = vqrshrn_n_u16(vld1q_u16(src + x), 2);
+        const uint8x8_t hi = vqrshrn_n_u16(vld1q_u16(src + x + 8), 2);
+        vst1q_u8(dst + x, vcombine_u8(lo, hi));
+    }
+    narrowScalar(src, dst, x, count);
+}
+
+#endif // YUV_ARCH_NEON
+
+using RowFunc = void (*)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, int);
+
+template <ColorMatrix M, ColorRange R>
+void convertRowScalarFull(const uint8_t* yRow, const uint8_t* uRow, const uint8_t* vRow,
+                          uint8_t* dstRow, int width) {
+    convertRowScalar<M, R>(yRow, uRow, vRow, dstRow, 0, width);
+}
+
+template <ColorMatrix M, ColorRange R>
+RowFunc rowFunction(Kernel kernel) {
+    switch (kernel) {
+#if defined(YUV_ARCH_X86)
+    case Kernel::Sse2: return &convertRowSse2<M, R>;
+    case Kernel::Avx2: return &convertRowAvx2<M, R>;
+#endif
+#if defined(YUV_ARCH_NEON)
+    case Kernel::Neon: return &convertRowNeon<M, R>;
+#endif
+    default: return &convertRowScalarFull<M, R>;
+    }
+}
+
+// Resolves the instantiation once per call; the row loop then runs a
+// kernel with its coefficients folded in as immediates.
+RowFunc rowFunction(Kernel kernel, ColorMatrix matrix, ColorRange range) {
+    const bool full = range == ColorRange::Full;
+    switch (matrix) {
+    case ColorMatrix::Bt709:
+        return full ? rowFunction<ColorMatrix::Bt709, ColorRange::Full>(kernel)
+                    : rowFunction<ColorMatrix::Bt709, ColorRange::Limited>(kernel);
+    case ColorMatrix::Bt2020:
+        return full ? rowFunction<ColorMatrix::Bt2020, ColorRange::Full>(kernel)
+                    : rowFunction<ColorMatrix::Bt2020, ColorRange::Limited>(kernel);
+    default:
+        return full ? rowFunction<ColorMatrix::Bt601, ColorRange::Full>(kernel)
+                    : rowFunction<ColorMatrix::Bt601, ColorRange::Limited>(kernel);
+    }
+}
+
+Kernel detectKernel() {
+    Kernel best = Kernel::Scalar;
+    if (isSupported(Kernel::Neon)) best = Kernel::Neon;
+    if (isSupported(Kernel::Sse2)) best = Kernel::Sse2;
+    if (isSupported(Kernel::Avx2)) best = Kernel::Avx2;
+
+    if (const char* forced = std::getenv("GHOST_YUV_KERNEL")) {
+        for (Kernel k : { Kernel::Scalar, Kernel::Sse2, Kernel::Avx2, Kernel::Neon }) {
+            if (std::strcmp(forced, kernelName(k)) == 0 && isSupported(k)) {
+                best = k;
+                break;
+            }
+        }
+    }
+
+    fprintf(stderr, "[GHOST] YUV→BGRA kernel: %s\n", kernelName(best));
+    fflush(stderr);
+    return best;
+}
+
+using NarrowFunc = void (*)(const uint16_t*, uint8_t*, int);
+
+void narrowScalarFull(const uint16_t* src, uint8_t* dst, int count) {
+    narrowScalar(src, dst, 0, count);
+}
+
+NarrowFunc narrowFunction(Kernel kernel) {
+    switch (kernel) {
+#if defined(YUV_ARCH_X86)
+    case Kernel::Sse2: return &narrowSse2;
+    case Kernel::Avx2: return &narrowAvx2;
+#endif
+#if defined(YUV_ARCH_NEON)
+    case Kernel::Neon: return &narrowNeon;
+#endif
+    default: return &narrowScalarFull;
+    }
+}
+
+/**
+ * @brief Maps every 10-bit limited-range luma code to an 8-bit SDR one
+ *
+ * Decodes the HDR signal to display light (PQ directly, HLG through its
+ * inverse OETF and the 1000 cd/m² reference OOTF), puts HDR reference white
+ * (203 cd/m², BT.2408) at SDR white, rolls highlights off with an extended
+ * Reinhard curve that reaches 1.0 at 1000 cd/m², and re-encodes with the
+ * BT.1886 gamma. Chroma is left alone, which is what keeps this cheap.
+ */
+std::array<uint8_t, 1024> buildToneMapLut(ToneMap toneMap) {
+    constexpr double kReferenceWhite = 203.0;
+    constexpr double kPeak = 1000.0 / kReferenceWhite;
+
+    std::array<uint8_t, 1024> lut{};
+    for (int code = 0; code < 1024; ++code) {
+        const double e = std::clamp((code - 64) / 876.0, 0.0, 1.0);
+        double nits = 0.0;
+        if (toneMap == ToneMap::Pq) {
+            constexpr double m1 = 2610.0 / 16384.0;
+            constexpr double m2 = 2523.0 / 4096.0 * 128.0;
+            constexpr double c1 = 3424.0 / 4096.0;
+            constexpr double c2 = 2413.0 / 4096.0 * 32.0;
+            constexpr double c3 = 2392.0 / 4096.0 * 32.0;
+            const double p = std::pow(e, 1.0 / m2);
+            nits = 10000.0 * std::pow(std::max(p - c1, 0.0) / (c2 - c3 * p), 1.0 / m1);
+        } else {
+            constexpr double a = 0.17883277;
+            constexpr double b = 0.28466892;
+            constexpr double c = 0.55991073;
+            const double scene = e <= 0.5 ? e * e / 3.0 : (std::exp((e - c) / a) + b) / 12.0;
+            nits = 1000.0 * std::pow(scene, 1.2);
+        }
+        const double x = nits / kReferenceWhite;
+        const double y = std::min(x * (1.0 + x / (kPeak * kPeak)) / (1.0 + x), 1.0);
+        const double v = std::pow(y, 1.0 / 2.4);
+        lut[code] = static_cast<uint8_t>(std::lround(16.0 + 219.0 * v));
+    }
+    return lut;
+}
+
+const uint8_t* toneMapLut(ToneMap toneMap) {
+    static const std::array<uint8_t, 1024> pq = buildToneMapLut(ToneMap::Pq);
+    static const std::array<uint8_t, 1024> hlg = buildToneMapLut(ToneMap::Hlg);
+    switch (toneMap) {
+    case ToneMap::Pq: return pq.data();
+    case ToneMap::Hlg: return hlg.data();
+    default: return nullptr;
+    }
+}
+
+void convertRows8(const I420Planes& src, uint8_t* dst, int dstPitch,
+                  int rowBegin, int rowEnd, Kernel kernel) {
+    const RowFunc convertRow = rowFunction(kernel, src.matrix, src.range);
+
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const uint8_t* yRow = src.y + y * src.pitchY;
+        const uint8_t* uRow = src.u + (y / 2) * src.pitchU;
+        const uint8_t* vRow = src.v + (y / 2) * src.pitchV;
+        convertRow(yRow, uRow, vRow, dst + y * dstPitch, src.width);
+    }
+}
+
+inline size_t alignUp64(size_t bytes) {
+    return (bytes + 63) & ~size_t(63);
+}
+
+/**
+ * @brief Returns at least `bytes` of 64-byte aligned scratch memory
+ *
+ * Kept per thread so slices converted in parallel never share it. Callers
+ * carve it into rows with alignUp64 so every row starts on a boundary.
+ */
+uint8_t* scratchBuffer(size_t bytes) {
+    thread_local std::vector<uint8_t> scratch;
+    if (scratch.size() < bytes + 63) scratch.resize(bytes + 63);
+    const uintptr_t base = (reinterpret_cast<uintptr_t>(scratch.data()) + 63) & ~uintptr_t(63);
+    return reinterpret_cast<uint8_t*>(base);
+}
+
+/**
+ * @brief 10-bit samples to the 8 bits the row kernels take, through the
+ *        tone-map LUT when one is given
+ */
+void toEightBit(const uint16_t* src, uint8_t* dst, int count,
+                const uint8_t* lut, NarrowFunc narrow) {
+    if (lut) {
+        for (int x = 0; x < count; ++x) {
+            dst[x] = lut[std::min<int>(src[x], 1023)];
+        }
+    } else {
+        narrow(src, dst, count);
+    }
+}
+
+/**
+ * @brief 10-bit rows: narrow into per-thread 8-bit scratch rows, then run
+ *        the regular 8-bit row kernel
+ *
+ * The scratch rows stay in L1, so this costs far less than narrowing the
+ * whole picture first. Chroma is narrowed once per row pair.
+ */
+void convertRows10(const I420Planes& src, uint8_t* dst, int dstPitch,
+                   int rowBegin, int rowEnd, Kernel kernel) {
+    const RowFunc convertRow = rowFunction(kernel, src.matrix, src.range);
+    const NarrowFunc narrow = narrowFunction(kernel);
+    const uint8_t* lut = toneMapLut(src.toneMap);
+
+    const int chromaWidth = (src.width + 1) / 2;
+    const size_t lumaBytes = alignUp64(src.width);
+    const size_t chromaBytes = alignUp64(chromaWidth);
+    uint8_t* yRow = scratchBuffer(lumaBytes + 2 * chromaBytes);
+    uint8_t* uRow = yRow + lumaBytes;
+    uint8_t* vRow = uRow + chromaBytes;
+
+    int chromaRow = -1;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        toEightBit(reinterpret_cast<const uint16_t*>(src.y + y * src.pitchY), yRow, src.width,
+                   lut, narrow);
+        if (y / 2 != chromaRow) {
+            chromaRow = y / 2;
+            narrow(reinterpret_cast<const uint16_t*>(src.u + chromaRow * src.pitchU), uRow, chromaWidth);
+            narrow(reinterpret_cast<const uint16_t*>(src.v + chromaRow * src.pitchV), vRow, chromaWidth);
+        }
+        convertRow(yRow, uRow, vRow, dst + y * dstPitch, src.width);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scaling. Each output row is a vertical pass (weighted sum of the source
+// rows it covers, kept at full source width) followed by a horizontal pass
+// down to the output width. Weights are 14-bit fixed point and samples at
+// most 10-bit, so pmaddwd's signed 16-bit inputs and 32-bit sums are exact
+// and the SIMD passes match the scalar ones bit for bit.
+// ---------------------------------------------------------------------------
+
+constexpr int kFilterBits = 14;
+constexpr int kFilterOne = 1 << kFilterBits;
+// Horizontal SIMD reads 2 or 4 samples from each output's first tap.
+constexpr int kPackedTaps = 4;
+
+inline int packedStride(int taps) {
+    return taps <= 2 ? 2 : kPackedTaps;
+}
+
+ScaleFilter::Axis makeAxis(int srcSize, int dstSize) {
+    ScaleFilter::Axis axis;
+    const double ratio = static_cast<double>(srcSize) / dstSize;
+    const bool area = ratio >= 2.0;
+    const int taps = area ? static_cast<int>(std::ceil(ratio)) + 1 : 2;
+    std::vector<int> index(static_cast<size_t>(dstSize) * taps, 0);
+    std::vector<int> weight(static_cast<size_t>(dstSize) * taps, 0);
+
+    std::vector<double> weights(taps);
+    for (int i = 0; i < dstSize; ++i) {
+        int* idx = &index[static_cast<size_t>(i) * taps];
+        int* w = &weight[static_cast<size_t>(i) * taps];
+
+        if (area) {
+            // Output sample i covers source interval [i * ratio, (i + 1) * ratio).
+            const double begin = i * ratio;
+            const double end = (i + 1) * ratio;
+            const int first = static_cast<int>(std::floor(begin));
+            for (int t = 0; t < taps; ++t) {
+                const int j = first + t;
+                const double covered = std::min<double>(j + 1, end) - std::max<double>(j, begin);
+                idx[t] = std::min(j, srcSize - 1);
+                weights[t] = std::max(covered, 0.0) / ratio;
+            }
+        } else {
+            // Pixel centres line up: output centre i + 0.5 maps to (i + 0.5) * ratio.
+            const double centre = (i + 0.5) * ratio - 0.5;
+            const int j = static_cast<int>(std::floor(centre));
+            const double frac = centre - j;
+            idx[0] = std::clamp(j, 0, srcSize - 1);
+            idx[1] = std::clamp(j + 1, 0, srcSize - 1);
+            weights[0] = 1.0 - frac;
+            weights[1] = frac;
+        }
+
+        // Round to fixed point and give the remainder to the largest tap, so
+        // flat areas come out exactly unchanged.
+        int sum = 0;
+        int largest = 0;
+        for (int t = 0; t < taps; ++t) {
+            w[t] = static_cast<int>(std::lround(weights[t] * kFilterOne));
+            sum += w[t];
+            if (w[t] > w[largest]) largest = t;
+        }
+        w[largest] += kFilterOne - sum;
+    }
+
+    // ceil(ratio) + 1 taps covers the worst alignment; when no output needs
+    // the last ones (exact 2× or 3× reductions) drop them so the row passes
+    // don't multiply by zero.
+    int used = 1;
+    for (int i = 0; i < dstSize; ++i) {
+        for (int t = taps - 1; t >= used; --t) {
+            if (weight[static_cast<size_t>(i) * taps + t] != 0) {
+                used = t + 1;
+                break;
+            }
+        }
+    }
+
+    axis.taps = used;
+    axis.contiguous = srcSize >= used;
+    axis.index.resize(static_cast<size_t>(dstSize) * used);
+    axis.weight.resize(static_cast<size_t>(dstSize) * used);
+    std::vector<int> dense(used);
+    for (int i = 0; i < dstSize; ++i) {
+        const int* idx = &index[static_cast<size_t>(i) * taps];
+        const int* w = &weight[static_cast<size_t>(i) * taps];
+        int* outIdx = &axis.index[static_cast<size_t>(i) * used];
+        int* outW = &axis.weight[static_cast<size_t>(i) * used];
+        if (!axis.contiguous) {
+            std::copy(idx, idx + used, outIdx);
+            std::copy(w, w + used, outW);
+            continue;
+        }
+        // Clamping at the edges can repeat a source sample. Fold repeats
+        // together so tap t is always sample start + t, which lets the SIMD
+        // pass load each output's taps with one unaligned read.
+        const int start = std::min(idx[0], srcSize - used);
+        std::fill(dense.begin(), dense.end(), 0);
+        for (int t = 0; t < used; ++t) dense[idx[t] - start] += w[t];
+        for (int t = 0; t < used; ++t) {
+            outIdx[t] = start + t;
+            outW[t] = dense[t];
+        }
+    }
+    axis.halves = srcSize == 2 * dstSize;
+    if (axis.contiguous && used <= kPackedTaps) {
+        const int stride = packedStride(used);
+        axis.packed.assign(static_cast<size_t>(dstSize) * stride, 0);
+        for (int i = 0; i < dstSize; ++i) {
+            for (int t = 0; t < used; ++t) {
+                axis.packed[static_cast<size_t>(i) * stride + t] =
+                    static_cast<int16_t>(axis.weight[static_cast<size_t>(i) * used + t]);
+            }
+        }
+    }
+    return axis;
+}
+
+/**
+ * @brief Reference vertical pass for columns [x, width)
+ */
+template <typename Sample>
+void verticalPassScalar(const Sample* const* lines, const int* weight, int taps,
+                        uint16_t* vert, int x, int width) {
+    for (; x < width; ++x) {
+        uint32_t sum = kFilterOne / 2;
+        for (int t = 0; t < taps; ++t) {
+            sum += static_cast<uint32_t>(weight[t]) * lines[t][x];
+        }
+        vert[x] = static_cast<uint16_t>(sum >> kFilterBits);
+    }
+}
+
+/**
+ * @brief Reference horizontal pass for outputs [x, width)
+ */
+template <typename Out>
+void horizontalPassScalar(const uint16_t* vert, const ScaleFilter::Axis& axis,
+                          Out* out, int x, int width) {
+    const int taps = axis.taps;
+    const int* index = axis.index.data() + static_cast<size_t>(x) * taps;
+    const int* weight = axis.weight.data() + static_cast<size_t>(x) * taps;
+    for (; x < width; ++x) {
+        uint32_t sum = kFilterOne / 2;
+        for (int t = 0; t < taps; ++t) {
+            sum += static_cast<uint32_t>(weight[t]) * vert[index[t]];
+        }
+        out[x] = static_cast<Out>(sum >> kFilterBits);
+        index += taps;
+        weight += taps;
+    }
+}
+
+#if defined(YUV_ARCH_X86)
+
+template <typename Sample>
+YUV_TARGET_SSE2 inline __m128i loadWidenedSse2(const Sample* p) {
+    if constexpr (sizeof(Sample) == 1) {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)),
+                                 _mm_setzero_si128());
+    } else {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+}
+
+// 8 columns per iteration; taps are consumed in pairs by pmaddwd.
+template <typename Sample>
+YUV_TARGET_SSE2 void verticalPassSse2(const Sample* const* lines, const int* weight, int taps,
+                                      uint16_t* vert, int width) {
+    constexpr int kMaxPairs = 8;
+    if (taps > 2 * kMaxPairs) {
+        verticalPassScalar(lines, weight, taps, vert, 0, width);
+        return;
+    }
+    __m128i coef[kMaxPairs];
+    const int pairs = (taps + 1) / 2;
+    for (int p = 0; p < pairs; ++p) {
+        coef[p] = pairCoefSse2(weight[2 * p], 2 * p + 1 < taps ? weight[2 * p + 1] : 0);
+    }
+
+    const __m128i round = _mm_set1_epi32(kFilterOne / 2);
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i lo = round;
+        __m128i hi = round;
+        for (int p = 0; p < pairs; ++p) {
+            const __m128i a = loadWidenedSse2(lines[2 * p] + x);
+            const __m128i b = 2 * p + 1 < taps ? loadWidenedSse2(lines[2 * p + 1] + x) : zero;
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), coef[p]));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), coef[p]));
+        }
+        const __m128i packed = _mm_packs_epi32(_mm_srai_epi32(lo, kFilterBits),
+                                               _mm_srai_epi32(hi, kFilterBits));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(vert + x), packed);
+    }
+    verticalPassScalar(lines, weight, taps, vert, x, width);
+}
+
+template <typename Out>
+YUV_TARGET_SSE2 inline void storeFourSse2(Out* out, __m128i sums) {
+    const __m128i words = _mm_packs_epi32(sums, sums);
+    if constexpr (sizeof(Out) == 1) {
+        const int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+        std::memcpy(out, &bytes, sizeof(bytes));
+    } else {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), words);
+    }
+}
+
+inline int loadPair(const uint16_t* p) {
+    int pair;
+    std::memcpy(&pair, p, sizeof(pair));
+    return pair;
+}
+
+// Bilinear and exact 2× box: each output's two taps are one 32-bit load,
+// and a single pmaddwd finishes four outputs.
+template <typename Out>
+YUV_TARGET_SSE2 void horizontalPass2Sse2(const uint16_t* vert, const ScaleFilter::Axis& axis,
+                                         Out* out, int width) {
+    const int* index = axis.index.data();
+    const int16_t* packed = axis.packed.data();
+    const __m128i round = _mm_set1_epi32(kFilterOne / 2);
+    const int taps = axis.taps;
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const int* start = index + static_cast<size_t>(x) * taps;
+        const __m128i pairs = _mm_setr_epi32(loadPair(vert + start[0]), loadPair(vert + start[taps]),
+                                             loadPair(vert + start[2 * taps]), loadPair(vert + start[3 * taps]));
+        const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + static_cast<size_t>(x) * 2));
+        storeFourSse2(out + x, _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, w), round), kFilterBits));
+    }
+    horizontalPassScalar(vert, axis, out, x, width);
+}
+
+// 3-4 taps: one 64-bit load per output plus pmaddwd against the
+// zero-padded weights gives two partial sums that a shuffle and add combine.
+template <typename Out>
+YUV_TARGET_SSE2 void horizontalPass4Sse2(const uint16_t* vert, const ScaleFilter::Axis& axis,
+                                         Out* out, int width) {
+    const int taps = axis.taps;
+    const int* index = axis.index.data();
+    const int16_t* packed = axis.packed.data();
+    const __m128i round = _mm_set1_epi32(kFilterOne / 2);
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const int* start = index + static_cast<size_t>(x) * taps;
+        const __m128i a = _mm_unpacklo_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(vert + start[0])),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(vert + start[taps])));
+        const __m128i b = _mm_unpacklo_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(vert + start[2 * taps])),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(vert + start[3 * taps])));
+        const __m128i* w = reinterpret_cast<const __m128i*>(packed + static_cast<size_t>(x) * kPackedTaps);
+        const __m128 ma = _mm_castsi128_ps(_mm_madd_epi16(a, _mm_loadu_si128(w)));
+        const __m128 mb = _mm_castsi128_ps(_mm_madd_epi16(b, _mm_loadu_si128(w + 1)));
+        const __m128i even = _mm_castps_si128(_mm_shuffle_ps(ma, mb, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(ma, mb, _MM_SHUFFLE(3, 1, 3, 1)));
+        storeFourSse2(out + x, _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), round), kFilterBits));
+    }
+    horizontalPassScalar(vert, axis, out, x, width);
+}
+
+// Exact 2:1 in both directions. With weights of exactly 1/2 the filter
+// reduces to (a + b + 1) >> 1 per pass, which is pavgb / pavgw, so this
+// matches the general passes bit for bit at a fraction of the cost.
+template <typename Sample, typename Out>
+YUV_TARGET_SSE2 void halveRowSse2(const Sample* line0, const Sample* line1, Out* out, int width) {
+    int x = 0;
+    if constexpr (sizeof(Sample) == 1) {
+        const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+        for (; x + 8 <= width; x += 8) {
+            const __m128i v = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line0 + 2 * x)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i*>(line1 + 2 * x)));
+            const __m128i h = _mm_avg_epu16(_mm_and_si128(v, lowBytes), _mm_srli_epi16(v, 8));
+            if constexpr (sizeof(Out) == 1) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(h, h));
+            } else {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), h);
+            }
+        }
+    } else {
+        const __m128i lowWords = _mm_set1_epi32(0xFFFF);
+        for (; x + 8 <= width; x += 8) {
+            const __m128i v0 = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line0 + 2 * x)),
+                                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(line1 + 2 * x)));
+            const __m128i v1 = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(line0 + 2 * x + 8)),
+                                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(line1 + 2 * x + 8)));
+            const __m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, lowWords), _mm_srli_epi32(v0, 16));
+            const __m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, lowWords), _mm_srli_epi32(v1, 16));
+            const __m128i h = _mm_packs_epi32(h0, h1);
+            if constexpr (sizeof(Out) == 1) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(h, h));
+            } else {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), h);
+            }
+        }
+    }
+    for (; x < width; ++x) {
+        const int left = (line0[2 * x] + line1[2 * x] + 1) >> 1;
+        const int right = (line0[2 * x + 1] + line1[2 * x + 1] + 1) >> 1;
+        out[x] = static_cast<Out>((left + right + 1) >> 1);
+    }
+}
+
+template <typename Sample>
+YUV_TARGET_AVX2 inline __m256i loadWidenedAvx2(const Sample* p) {
+    if constexpr (sizeof(Sample) == 1) {
+        return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    } else {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+}
+
+// Same as the SSE2 pass at 16 columns per iteration. unpack and pack are
+// both in-lane, so the column order survives.
+template <typename Sample>
+YUV_TARGET_AVX2 void verticalPassAvx2(const Sample* const* lines, const int* weight, int taps,
+                                      uint16_t* vert, int width) {
+    constexpr int kMaxPairs = 8;
+    if (taps > 2 * kMaxPairs) {
+        verticalPassScalar(lines, weight, taps, vert, 0, width);
+        return;
+    }
+    __m256i coef[kMaxPairs];
+    const int pairs = (taps + 1) / 2;
+    for (int p = 0; p < pairs; ++p) {
+        coef[p] = pairCoefAvx2(weight[2 * p], 2 * p + 1 < taps ? weight[2 * p + 1] : 0);
+    }
+
+    const __m256i round = _mm256_set1_epi32(kFilterOne / 2);
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i lo = round;
+        __m256i hi = round;
+        for (int p = 0; p < pairs; ++p) {
+            const __m256i a = loadWidenedAvx2(lines[2 * p] + x);
+            const __m256i b = 2 * p + 1 < taps ? loadWidenedAvx2(lines[2 * p + 1] + x) : zero;
+            lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), coef[p]));
+            hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), coef[p]));
+        }
+        const __m256i packed = _mm256_packs_epi32(_mm256_srai_epi32(lo, kFilterBits),
+                                                  _mm256_srai_epi32(hi, kFilterBits));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(vert + x), packed);
+    }
+    verticalPassScalar(lines, weight, taps, vert, x, width);
+}
+
+#endif // YUV_ARCH_X86
+
+#if defined(YUV_ARCH_NEON)
+
+template <typename Sample>
+void verticalPassNeon(const Sample* const* lines, const int* weight, int taps,
+                      uint16_t* vert, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint32x4_t lo = vdupq_n_u32(kFilterOne / 2);
+        uint32x4_t hi = vdupq_n_u32(kFilterOne / 2);
+        for (int t = 0; t < taps; ++t) {
+            uint16x8_t s;
+            if constexpr (sizeof(Sample) == 1) {
+                s = vmovl_u8(vld1_u8(reinterpret_cast<const uint8_t*>(lines[t] + x)));
+            } else {
+                s = vld1q_u16(reinterpret_cast<const uint16_t*>(lines[t] + x));
+            }
+            const uint16_t w = static_cast<uint16_t>(weight[t]);
+            lo = vmlal_n_u16(lo, vget_low_u16(s), w);
+            hi = vmlal_n_u16(hi, vget_high_u16(s), w);
+        }
+        vst1q_u16(vert + x, vcombine_u16(vshrn_n_u32(lo, kFilterBits), vshrn_n_u32(hi, kFilterBits)));
+    }
+    verticalPassScalar(lines, weight, taps, vert, x, width);
+}
+
+#endif // YUV_ARCH_NEON
+
+/**
+ * @brief Resamples output row `row` of one plane into out[0, dstWidth)
+ *
+ * vert needs room for srcWidth + kPackedTaps entries. Results are in source
+ * sample units (0-255 or 0-1023).
+ */
+template <typename Sample, typename Out>
+void resampleRow(const uint8_t* plane, int pitch, int srcWidth,
+                 const ScaleFilter::Axis& ax, const ScaleFilter::Axis& ay, int row,
+                 uint16_t* vert, Out* out, int dstWidth, Kernel kernel) {
+    const int* rowIndex = &ay.index[static_cast<size_t>(row) * ay.taps];
+    const int* rowWeight = &ay.weight[static_cast<size_t>(row) * ay.taps];
+
+    constexpr int kMaxStackTaps = 16;
+    const Sample* stackLines[kMaxStackTaps];
+    std::vector<const Sample*> heapLines;
+    const Sample** lines = stackLines;
+    if (ay.taps > kMaxStackTaps) {
+        heapLines.resize(ay.taps);
+        lines = heapLines.data();
+    }
+    for (int t = 0; t < ay.taps; ++t) {
+        lines[t] = reinterpret_cast<const Sample*>(plane + static_cast<size_t>(rowIndex[t]) * pitch);
+    }
+
+#if defined(YUV_ARCH_X86)
+    if (kernel != Kernel::Scalar && ax.halves && ay.halves) {
+        halveRowSse2(lines[0], lines[1], out, dstWidth);
+        return;
+    }
+#endif
+
+    switch (kernel) {
+#if defined(YUV_ARCH_X86)
+    case Kernel::Sse2:
+        verticalPassSse2(lines, rowWeight, ay.taps, vert, srcWidth);
+        break;
+    case Kernel::Avx2:
+        verticalPassAvx2(lines, rowWeight, ay.taps, vert, srcWidth);
+        break;
+#endif
+#if defined(YUV_ARCH_NEON)
+    case Kernel::Neon:
+        verticalPassNeon(lines, rowWeight, ay.taps, vert, srcWidth);
+        break;
+#endif
+    default:
+        verticalPassScalar(lines, rowWeight, ay.taps, vert, 0, srcWidth);
+        break;
+    }
+    // Keep the over-read of the last outputs' taps on defined values; their
+    // weights are zero.
+    std::fill(vert + srcWidth, vert + srcWidth + kPackedTaps, uint16_t(0));
+
+#if defined(YUV_ARCH_X86)
+    if (kernel != Kernel::Scalar && !ax.packed.empty()) {
+        if (ax.taps <= 2) {
+            horizontalPass2Sse2(vert, ax, out, dstWidth);
+        } else {
+            horizontalPass4Sse2(vert, ax, out, dstWidth);
+        }
+        return;
+    }
+#endif
+    horizontalPassScalar(vert, ax, out, 0, dstWidth);
+}
+
+void convertScaledRows(const I420Planes& src, const ScaleFilter& filter, uint8_t* dst, int dstPitch,
+                       int rowBegin, int rowEnd, Kernel kernel) {
+    const RowFunc convertRow = rowFunction(kernel, src.matrix, src.range);
+    const NarrowFunc narrow = narrowFunction(kernel);
+    const bool wide = src.bitDepth > 8;
+    const uint8_t* lut = wide ? toneMapLut(src.toneMap) : nullptr;
+
+    const int srcChromaWidth = (filter.srcWidth + 1) / 2;
+    const int dstChromaWidth = (filter.dstWidth + 1) / 2;
+    const size_t vertBytes = alignUp64(sizeof(uint16_t) * (filter.srcWidth + kPackedTaps));
+    const size_t wideBytes = alignUp64(sizeof(uint16_t) * filter.dstWidth);
+    const size_t lumaBytes = alignUp64(filter.dstWidth);
+    const size_t chromaBytes = alignUp64(dstChromaWidth);
+    uint8_t* base = scratchBuffer(vertBytes + wideBytes + lumaBytes + 2 * chromaBytes);
+    auto* vert = reinterpret_cast<uint16_t*>(base);
+    auto* wideRow = reinterpret_cast<uint16_t*>(base + vertBytes);
+    uint8_t* yRow = base + vertBytes + wideBytes;
+    uint8_t* uRow = yRow + lumaBytes;
+    uint8_t* vRow = uRow + chromaBytes;
+
+    // Resamples one plane's row straight to 8 bits; 10-bit goes through the
+    // narrowing (or tone-map) step on the way.
+    auto resample = [&](const uint8_t* plane, int pitch, int srcWidth, const ScaleFilter::Axis& ax,
+                        const ScaleFilter::Axis& ay, int row, int dstWidth, uint8_t* dstRow,
+                        const uint8_t* rowLut) {
+        if (wide) {
+            resampleRow<uint16_t>(plane, pitch, srcWidth, ax, ay, row, vert, wideRow, dstWidth, kernel);
+            toEightBit(wideRow, dstRow, dstWidth, rowLut, narrow);
+        } else {
+            resampleRow<uint8_t>(plane, pitch, srcWidth, ax, ay, row, vert, dstRow, dstWidth, kernel);
+        }
+    };
+
+    int chromaRow = -1;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        resample(src.y, src.pitchY, filter.srcWidth, filter.lumaX, filter.lumaY, y,
+                 filter.dstWidth, yRow, lut);
+        if (y / 2 != chromaRow) {
+            chromaRow = y / 2;
+            resample(src.u, src.pitchU, srcChromaWidth, filter.chromaX, filter.chromaY, chromaRow,
+                     dstChromaWidth, uRow, nullptr);
+            resample(src.v, src.pitchV, srcChromaWidth, filter.chromaX, filter.chromaY, chromaRow,
+                     dstChromaWidth, vRow, nullptr);
+        }
+        convertRow(yRow, uRow, vRow, dst + y * dstPitch, filter.dstWidth);
+    }
+}
+
+template <typename Sample>
+void scalePlaneRows(const uint8_t* plane, int pitch, int srcWidth,
+                    const ScaleFilter::Axis& ax, const ScaleFilter::Axis& ay,
+                    uint8_t* dst, int dstPitch, int dstWidth, int rowBegin, int rowEnd, Kernel kernel) {
+    auto* vert = reinterpret_cast<uint16_t*>(scratchBuffer(sizeof(uint16_t) * (srcWidth + kPackedTaps)));
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        auto* dstRow = reinterpret_cast<Sample*>(dst + static_cast<size_t>(y) * dstPitch);
+        resampleRow<Sample>(plane, pitch, srcWidth, ax, ay, y, vert, dstRow, dstWidth, kernel);
+    }
+}
+
+void convertRows(const I420Planes& src, uint8_t* dst, int dstPitch,
+                 int rowBegin, int rowEnd, Kernel kernel) {
+    if (src.bitDepth > 8) {
+        convertRows10(src, dst, dstPitch, rowBegin, rowEnd, kernel);
+    } else {
+        convertRows8(src, dst, dstPitch, rowBegin, rowEnd, kernel);
+    }
+}
+
+} // namespace
+
+bool isSupported(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar: return true;
+#if defined(YUV_ARCH_X86)
+    case Kernel::Sse2: return cpuHasSse2();
+    case Kernel::Avx2: return cpuHasAvx2();
+#endif
+#if defined(YUV_ARCH_NEON)
+    case Kernel::Neon: return true; // NEON is mandatory on AArch64
+#endif
+    default: return false;
+    }
+}
+
+const char* kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar: return "scalar";
+    case Kernel::Sse2: return "sse2";
+    case Kernel::Avx2: return "avx2";
+    case Kernel::Neon: return "neon";
+    }
+    return "unknown";
+}
+
+const char* colorMatrixName(ColorMatrix matrix) {
+    switch (matrix) {
+    case ColorMatrix::Bt601: return "bt601";
+    case ColorMatrix::Bt709: return "bt709";
+    case ColorMatrix::Bt2020: return "bt2020";
+    }
+    return "unknown";
+}
+
+ColorMatrix guessColorMatrix(int width, int height, bool hdr) {
+    if (hdr) return ColorMatrix::Bt2020;
+    if (width > 1024 || height > 576) return ColorMatrix::Bt709;
+    return ColorMatrix::Bt601;
+}
+
+ToneMap toneMapFromString(const char* name) {
+    if (!name) return ToneMap::None;
+    std::string lower(name);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (lower == "pq") return ToneMap::Pq;
+    if (lower == "hlg") return ToneMap::Hlg;
+    return ToneMap::None;
+}
+
+const char* toneMapName(ToneMap toneMap) {
+    switch (toneMap) {
+    case ToneMap::None: return "none";
+    case ToneMap::Pq: return "pq";
+    case ToneMap::Hlg: return "hlg";
+    }
+    return "unknown";
+}
+
+Kernel activeKernel() {
+    static const Kernel kernel = detectKernel();
+    return kernel;
+}
+
+void convertI420ToBgra(const I420Planes& src, uint8_t* dst, int dstPitch) {
+    convertI420ToBgra(src, dst, dstPitch, activeKernel());
+}
+
+void convertI420ToBgra(const I420Planes& src, uint8_t* dst, int dstPitch, Kernel kernel) {
+    convertRows(src, dst, dstPitch, 0, src.height, isSupported(kernel) ? kernel : Kernel::Scalar);
+}
+
+void convertI420ToBgraRows(const I420Planes& src, uint8_t* dst, int dstPitch,
+                           int rowBegin, int rowEnd) {
+    convertRows(src, dst, dstPitch, rowBegin, rowEnd, activeKernel());
+}
+
+ScaleFilter makeScaleFilter(int srcWidth, int srcHeight, int dstWidth, int dstHeight) {
+    ScaleFilter filter;
+    filter.srcWidth = srcWidth;
+    filter.srcHeight = srcHeight;
+    filter.dstWidth = dstWidth;
+    filter.dstHeight = dstHeight;
+    filter.lumaX = makeAxis(srcWidth, dstWidth);
+    filter.lumaY = makeAxis(srcHeight, dstHeight);
+    filter.chromaX = makeAxis((srcWidth + 1) / 2, (dstWidth + 1) / 2);
+    filter.chromaY = makeAxis((srcHeight + 1) / 2, (dstHeight + 1) / 2);
+    return filter;
+}
+
+void convertI420ToBgraScaledRows(const I420Planes& src, const ScaleFilter& filter,
+                                 uint8_t* dst, int dstPitch, int rowBegin, int rowEnd) {
+    convertScaledRows(src, filter, dst, dstPitch, rowBegin, rowEnd, activeKernel());
+}
+
+void convertI420ToBgraScaledRows(const I420Planes& src, const ScaleFilter& filter,
+                                 uint8_t* dst, int dstPitch, int rowBegin, int rowEnd, Kernel kernel) {
+    convertScaledRows(src, filter, dst, dstPitch, rowBegin, rowEnd,
+                      isSupported(kernel) ? kernel : Kernel::Scalar);
+}
+
+void scaleI420Rows(const I420Planes& src, const ScaleFilter& filter,
+                   uint8_t* const dstPlanes[3], const int dstPitches[3],
+                   int rowBegin, int rowEnd) {
+    scaleI420Rows(src, filter, dstPlanes, dstPitches, rowBegin, rowEnd, activeKernel());
+}
+
+void scaleI420Rows(const I420Planes& src, const ScaleFilter& filter,
+                   uint8_t* const dstPlanes[3], const int dstPitches[3],
+                   int rowBegin, int rowEnd, Kernel kernel) {
+    if (!isSupported(kernel))
+        kernel = Kernel::Scalar;
+    const int srcChromaWidth = (filter.srcWidth + 1) / 2;
+    const int dstChromaWidth = (filter.dstWidth + 1) / 2;
+    const int chromaBegin = rowBegin / 2;
+    const int chromaEnd = (rowEnd + 1) / 2;
+    auto scale = src.bitDepth > 8 ? &scalePlaneRows<uint16_t> : &scalePlaneRows<uint8_t>;
+    scale(src.y, src.pitchY, filter.srcWidth, filter.lumaX, filter.lumaY,
+          dstPlanes[0], dstPitches[0], filter.dstWidth, rowBegin, rowEnd, kernel);
+    scale(src.u, src.pitchU, srcChromaWidth, filter.chromaX, filter.chromaY,
+          dstPlanes[1], dstPitches[1], dstChromaWidth, chromaBegin, chromaEnd, kernel);
+    scale(src.v, src.pitchV, srcChromaWidth, filter.chromaX, filter.chromaY,
+          dstPlanes[2], dstPitches[2], dstChromaWidth, chromaBegin, chromaEnd, kernel);
+}
+
+void narrow10To8(const uint16_t* src, uint8_t* dst, int count) {
+    narrowFunction(activeKernel())(src, dst, count);
+}
+
+void narrow10To8(const uint16_t* src, uint8_t* dst, int count, Kernel kernel) {
+    narrowFunction(isSupported(kernel) ? kernel : Kernel::Scalar)(src, dst, count);
+}
+
+} // namespace YuvConverter
@@ -0,0 +1,211 @@
+#ifndef YUVCONVERTER_H
+#define YUVCONVERTER_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief CPU colour conversion kernels for decoded libVLC frames
+ *
+ * Converts 8-bit I420 (YUV 4:2:0 planar) pictures into 32-bit BGRA. The
+ * scalar loop is the reference implementation; SSE2, AVX2 and NEON kernels
+ * produce bit-identical output and are picked once at runtime from the
+ * features the CPU reports.
+ *
+ * Every kernel is a template on colour matrix and range with constexpr
+ * coefficients, so the inner loops carry no per-pixel branches; the
+ * instantiation is chosen once per call from I420Planes.
+ *
+ * When the picture is shown smaller than it was decoded, the scaled
+ * variants resample straight from the YUV planes so only output-sized rows
+ * are ever converted or uploaded.
+ *
+ * 10-bit I0AL pictures are narrowed to 8 bits a row at a time (optionally
+ * through a PQ/HLG → SDR luma tone curve) and then run through the same
+ * kernels.
+ */
+namespace YuvConverter {
+
+/** @brief Transfer function assumed for 10-bit sources on the CPU path */
+enum class ToneMap {
+    None,  // SDR: plain rounding shift to 8 bits
+    Pq,    // SMPTE ST 2084, as used by HDR10
+    Hlg,   // ARIB STD-B67 hybrid log-gamma
+};
+
+/** @brief YUV → RGB matrix the source was encoded with */
+enum class ColorMatrix {
+    Bt601,   // SD
+    Bt709,   // HD
+    Bt2020,  // UHD / HDR
+};
+
+/** @brief Quantisation range of the source samples */
+enum class ColorRange {
+    Limited,  // "TV" range: Y 16-235, chroma 16-240
+    Full,     // "PC" / JPEG range: 0-255
+};
+
+/** @brief Read-only view over the three planes of an I420 picture */
+struct I420Planes {
+    const uint8_t* y = nullptr;
+    const uint8_t* u = nullptr;
+    const uint8_t* v = nullptr;
+    int pitchY = 0;
+    int pitchU = 0;
+    int pitchV = 0;
+    int width = 0;   // visible width in pixels
+    int height = 0;  // visible height in pixels
+    // 8, or 10 for I0AL: little-endian 16-bit samples, pitches still in bytes
+    int bitDepth = 8;
+    // Only used when bitDepth is 10
+    ToneMap toneMap = ToneMap::None;
+    ColorMatrix matrix = ColorMatrix::Bt601;
+    ColorRange range = ColorRange::Limited;
+};
+
+/** @brief Row kernels available for the I420 → BGRA conversion */
+enum class Kernel {
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon,
+};
+
+/**
+ * @brief Returns the fastest kernel supported by this CPU
+ *
+ * Resolved once and cached. Setting GHOST_YUV_KERNEL=scalar|sse2|avx2|neon
+ * in the environment forces a specific kernel when it is supported.
+ */
+Kernel activeKernel();
+
+/** @brief Returns true if the given kernel can run on this CPU */
+bool isSupported(Kernel kernel);
+
+/** @brief Human readable kernel name, used in logs */
+const char* kernelName(Kernel kernel);
+
+/** @brief Human readable matrix name, used in logs */
+const char* colorMatrixName(ColorMatrix matrix);
+
+/**
+ * @brief Best guess at the matrix when the stream doesn't say
+ *
+ * Follows what encoders do in practice: BT.2020 for HDR, BT.709 for
+ * anything larger than PAL SD, BT.601 below that.
+ */
+ColorMatrix guessColorMatrix(int width, int height, bool hdr);
+
+/** @brief Parses "pq", "hlg" or anything else (None), case-insensitively */
+ToneMap toneMapFromString(const char* name);
+
+/** @brief Human readable tone map name, used in logs */
+const char* toneMapName(ToneMap toneMap);
+
+/**
+ * @brief Precomputed filter taps for downscaling an I420 picture
+ *
+ * Built once per (source, destination) geometry and shared read-only by all
+ * slices of a frame. Axes shrunk by 2× or more use an area (box) filter,
+ * which averages every source sample exactly once; milder reductions use
+ * bilinear. Weights of each output sample sum to 1 << 14.
+ */
+struct ScaleFilter {
+    struct Axis {
+        int taps = 0;
+        // Tap t of every output is source sample index[0] + t. Only false
+        // when the source is smaller than the tap count.
+        bool contiguous = false;
+        // Exact 2:1 box (source twice the output): every output averages
+        // samples 2i and 2i + 1 with equal weights.
+        bool halves = false;
+        std::vector<int> index;       // dst * taps source positions, clamped
+        std::vector<int> weight;      // dst * taps weights
+        std::vector<int16_t> packed;  // dst * 2 (taps <= 2) or dst * 4 zero-padded weights for SIMD; empty if taps > 4
+    };
+
+    int srcWidth = 0;
+    int srcHeight = 0;
+    int dstWidth = 0;
+    int dstHeight = 0;
+    Axis lumaX;
+    Axis lumaY;
+    Axis chromaX;
+    Axis chromaY;
+
+    /** @brief True if the filter was built for exactly this geometry */
+    bool matches(int srcW, int srcH, int dstW, int dstH) const {
+        return srcWidth == srcW && srcHeight == srcH && dstWidth == dstW && dstHeight == dstH;
+    }
+};
+
+/** @brief Builds the filter taps for scaling srcW × srcH down to dstW × dstH */
+ScaleFilter makeScaleFilter(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+
+/**
+ * @brief Scales and converts destination rows [rowBegin, rowEnd) to BGRA
+ *
+ * The fused equivalent of scaling the YUV planes and then calling
+ * convertI420ToBgraRows: rows are resampled into per-thread scratch and
+ * fed straight to the active kernel. dst points at destination row 0.
+ */
+void convertI420ToBgraScaledRows(const I420Planes& src, const ScaleFilter& filter,
+                                 uint8_t* dst, int dstPitch, int rowBegin, int rowEnd);
+
+/** @brief As above with an explicit kernel; unsupported ones fall back to scalar */
+void convertI420ToBgraScaledRows(const I420Planes& src, const ScaleFilter& filter,
+                                 uint8_t* dst, int dstPitch, int rowBegin, int rowEnd, Kernel kernel);
+
+/**
+ * @brief Scales luma rows [rowBegin, rowEnd) into another I420 / I0AL picture
+ *
+ * Chroma rows rowBegin / 2 up to (rowEnd + 1) / 2 are written alongside, so
+ * slices must start on even rows. Samples keep their bit depth.
+ */
+void scaleI420Rows(const I420Planes& src, const ScaleFilter& filter,
+                   uint8_t* const dstPlanes[3], const int dstPitches[3],
+                   int rowBegin, int rowEnd);
+
+/** @brief As above with an explicit kernel; unsupported ones fall back to scalar */
+void scaleI420Rows(const I420Planes& src, const ScaleFilter& filter,
+                   uint8_t* const dstPlanes[3], const int dstPitches[3],
+                   int rowBegin, int rowEnd, Kernel kernel);
+
+/**
+ * @brief Narrows 10-bit samples to 8 bits with rounding, (s + 2) >> 2
+ *
+ * Uses the SIMD width of the active kernel. Values above 1023 saturate.
+ */
+void narrow10To8(const uint16_t* src, uint8_t* dst, int count);
+
+/** @brief As above with an explicit kernel; unsupported ones fall back to scalar */
+void narrow10To8(const uint16_t* src, uint8_t* dst, int count, Kernel kernel);
+
+/**
+ * @brief Converts a whole I420 picture to BGRA using the active kernel
+ * @param src Source planes
+ * @param dst Destination BGRA buffer (4 bytes per pixel)
+ * @param dstPitch Bytes per destination row
+ */
+void convertI420ToBgra(const I420Planes& src, uint8_t* dst, int dstPitch);
+
+/**
+ * @brief Converts a whole I420 picture to BGRA using an explicit kernel
+ *
+ * Falls back to the scalar kernel if the requested one is not supported.
+ */
+void convertI420ToBgra(const I420Planes& src, uint8_t* dst, int dstPitch, Kernel kernel);
+
+/**
+ * @brief Converts rows [rowBegin, rowEnd) using the active kernel
+ *
+ * Used to split a frame into slices converted on several threads. dst
+ * points at row 0 of the destination, not at rowBegin.
+ */
+void convertI420ToBgraRows(const I420Planes& src, uint8_t* dst, int dstPitch,
+                           int rowBegin, int rowEnd);
+
+} // namespace YuvConverter
+
+#endif // YUVCONVERTER_H
@@ -0,0 +1,237 @@
+/**
+ * @file YuvConverterTest.cpp
+ * @brief Checks every SIMD kernel against the scalar reference, bit for bit
+ *
+ * Covers each kernel this CPU supports × colour matrix × range × 8/10-bit
+ * (10-bit also through each tone map), on odd and SIMD-aligned widths, for
+ * the plain conversion, the fused scale + convert, the plane scaler and
+ * the 10 → 8-bit narrowing. Sources are random with random pitch padding.
+ * Exits non-zero on the first mismatching combination of each kind.
+ *
+ * Usage:
+ *   YuvConverterTest [--seed N]
+ */
+
+#include "YuvConverter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace YuvConverter;
+
+namespace {
+
+const Kernel kKernels[] = { Kernel::Sse2, Kernel::Avx2, Kernel::Neon };
+const ColorMatrix kMatrices[] = { ColorMatrix::Bt601, ColorMatrix::Bt709, ColorMatrix::Bt2020 };
+const ColorRange kRanges[] = { ColorRange::Limited, ColorRange::Full };
+const ToneMap kToneMaps[] = { ToneMap::None, ToneMap::Pq, ToneMap::Hlg };
+// Odd widths exercise the scalar tails, the others whole SIMD blocks only.
+const int kWidths[] = { 1, 2, 3, 7, 15, 17, 31, 33, 63, 65, 101, 16, 32, 64, 128, 256 };
+const int kHeights[] = { 1, 2, 5, 8 };
+// Scaled geometries: exact 2:1, 3:1 and 4:1 boxes, mild bilinear, odd sizes.
+struct Scale { int srcW, srcH, dstW, dstH; };
+const Scale kScales[] = {
+    { 64, 32, 32, 16 }, { 96, 48, 32, 16 }, { 256, 64, 64, 16 }, { 100, 40, 80, 30 },
+    { 101, 37, 33, 12 }, { 199, 75, 131, 50 }, { 65, 9, 64, 8 }, { 1920, 8, 1280, 6 },
+    { 3, 3, 1, 1 }, { 128, 16, 127, 15 },
+};
+
+std::mt19937 rng;
+int failures = 0;
+
+/** @brief Random planes of the given geometry, padded like VLC's */
+struct Picture {
+    std::vector<uint8_t> data[3];
+    I420Planes planes;
+
+    Picture(int width, int height, int bitDepth, bool overRange = false) {
+        const int bytes = bitDepth > 8 ? 2 : 1;
+        const int chromaW = (width + 1) / 2;
+        const int chromaH = (height + 1) / 2;
+        const int pad = static_cast<int>(rng() % 64);
+        int pitches[3] = { (width + pad) * bytes, (chromaW + pad / 2) * bytes, (chromaW + pad / 2) * bytes };
+        const int heights[3] = { height, chromaH, chromaH };
+        for (int p = 0; p < 3; ++p) {
+            // Slack after the last row: kernels may read whole vectors.
+            data[p].resize(static_cast<size_t>(pitches[p]) * heights[p] + 128);
+            if (bytes == 1) {
+                for (uint8_t& b : data[p]) b = static_cast<uint8_t>(rng());
+            } else {
+                const unsigned limit = overRange ? 65536 : 1024;
+                uint16_t* samples = reinterpret_cast<uint16_t*>(data[p].data());
+                for (size_t i = 0; i < data[p].size() / 2; ++i) samples[i] = static_cast<uint16_t>(rng() % limit);
+            }
+        }
+        planes.y = data[0].data();
+        planes.u = data[1].data();
+        planes.v = data[2].data();
+        planes.pitchY = pitches[0];
+        planes.pitchU = pitches[1];
+        planes.pitchV = pitches[2];
+        planes.width = width;
+        planes.height = height;
+        planes.bitDepth = bitDepth;
+    }
+};
+
+bool rowsEqual(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int pitch, int rowBytes, int rows) {
+    for (int y = 0; y < rows; ++y) {
+        if (std::memcmp(a.data() + y * pitch, b.data() + y * pitch, rowBytes) != 0)
+            return false;
+    }
+    return true;
+}
+
+void fail(const char* test, Kernel kernel, const I420Planes& src, int w, int h) {
+    ++failures;
+    fprintf(stderr, "FAIL %s: %s %s %s %d-bit tone %s, %dx%d -> %dx%d\n", test, kernelName(kernel),
+            colorMatrixName(src.matrix), src.range == ColorRange::Full ? "full" : "limited",
+            src.bitDepth, toneMapName(src.toneMap), src.width, src.height, w, h);
+}
+
+/** @brief Matrix × range × bit depth × tone map for one source geometry */
+template <typename Check>
+void forEachFormat(int width, int height, Check check) {
+    for (int bitDepth : { 8, 10 }) {
+        Picture picture(width, height, bitDepth);
+        for (ColorMatrix matrix : kMatrices) {
+            for (ColorRange range : kRanges) {
+                for (ToneMap toneMap : kToneMaps) {
+                    if (bitDepth == 8 && toneMap != ToneMap::None)
+                        continue;
+                    I420Planes src = picture.planes;
+                    src.matrix = matrix;
+                    src.range = range;
+                    src.toneMap = toneMap;
+                    check(src);
+                }
+            }
+        }
+    }
+}
+
+int testConvert(Kernel kernel) {
+    int cases = 0;
+    for (int width : kWidths) {
+        for (int height : kHeights) {
+            forEachFormat(width, height, [&](const I420Planes& src) {
+                const int pitch = width * 4 + 64;
+                std::vector<uint8_t> expected(static_cast<size_t>(pitch) * height, 0xAB);
+                std::vector<uint8_t> actual(expected.size(), 0xAB);
+                convertI420ToBgra(src, expected.data(), pitch, Kernel::Scalar);
+                convertI420ToBgra(src, actual.data(), pitch, kernel);
+                // The whole rows, so writes past the visible width fail too.
+                if (actual != expected)
+                    fail("convert", kernel, src, width, height);
+                ++cases;
+            });
+        }
+    }
+    return cases;
+}
+
+int testScaledConvert(Kernel kernel) {
+    int cases = 0;
+    for (const Scale& scale : kScales) {
+        const ScaleFilter filter = makeScaleFilter(scale.srcW, scale.srcH, scale.dstW, scale.dstH);
+        forEachFormat(scale.srcW, scale.srcH, [&](const I420Planes& src) {
+            const int pitch = scale.dstW * 4 + 64;
+            std::vector<uint8_t> expected(static_cast<size_t>(pitch) * scale.dstH, 0xAB);
+            std::vector<uint8_t> actual(expected.size(), 0xAB);
+            convertI420ToBgraScaledRows(src, filter, expected.data(), pitch, 0, scale.dstH, Kernel::Scalar);
+            // In two slices, as FrameSlicer would run it.
+            const int split = scale.dstH / 2;
+            convertI420ToBgraScaledRows(src, filter, actual.data(), pitch, 0, split, kernel);
+            convertI420ToBgraScaledRows(src, filter, actual.data(), pitch, split, scale.dstH, kernel);
+            if (actual != expected)
+                fail("scaled convert", kernel, src, scale.dstW, scale.dstH);
+            ++cases;
+        });
+    }
+    return cases;
+}
+
+int testScalePlanes(Kernel kernel) {
+    int cases = 0;
+    for (const Scale& scale : kScales) {
+        const ScaleFilter filter = makeScaleFilter(scale.srcW, scale.srcH, scale.dstW, scale.dstH);
+        for (int bitDepth : { 8, 10 }) {
+            const Picture picture(scale.srcW, scale.srcH, bitDepth);
+            const int bytes = bitDepth > 8 ? 2 : 1;
+            const int chromaW = (scale.dstW + 1) / 2;
+            const int chromaH = (scale.dstH + 1) / 2;
+            const int pitches[3] = { scale.dstW * bytes + 64, chromaW * bytes + 64, chromaW * bytes + 64 };
+            const int rows[3] = { scale.dstH, chromaH, chromaH };
+            std::vector<uint8_t> expected[3];
+            std::vector<uint8_t> actual[3];
+            for (int p = 0; p < 3; ++p) {
+                expected[p].assign(static_cast<size_t>(pitches[p]) * rows[p], 0xAB);
+                actual[p].assign(expected[p].size(), 0xAB);
+            }
+            uint8_t* const expectedPlanes[3] = { expected[0].data(), expected[1].data(), expected[2].data() };
+            uint8_t* const actualPlanes[3] = { actual[0].data(), actual[1].data(), actual[2].data() };
+            scaleI420Rows(picture.planes, filter, expectedPlanes, pitches, 0, scale.dstH, Kernel::Scalar);
+            const int split = scale.dstH / 2 & ~1;  // slices start on even rows
+            scaleI420Rows(picture.planes, filter, actualPlanes, pitches, 0, split, kernel);
+            scaleI420Rows(picture.planes, filter, actualPlanes, pitches, split, scale.dstH, kernel);
+            for (int p = 0; p < 3; ++p) {
+                if (!rowsEqual(actual[p], expected[p], pitches[p], pitches[p], rows[p])) {
+                    fail("scale planes", kernel, picture.planes, scale.dstW, scale.dstH);
+                    break;
+                }
+            }
+            ++cases;
+        }
+    }
+    return cases;
+}
+
+int testNarrow(Kernel kernel) {
+    int cases = 0;
+    for (int count : kWidths) {
+        // Includes values above 1023, which must saturate identically.
+        const Picture picture(count, 1, 10, true);
+        const uint16_t* samples = reinterpret_cast<const uint16_t*>(picture.planes.y);
+        std::vector<uint8_t> expected(count + 64, 0xAB);
+        std::vector<uint8_t> actual(expected.size(), 0xAB);
+        narrow10To8(samples, expected.data(), count, Kernel::Scalar);
+        narrow10To8(samples, actual.data(), count, kernel);
+        if (actual != expected)
+            fail("narrow", kernel, picture.planes, count, 1);
+        ++cases;
+    }
+    return cases;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    unsigned seed = 20240611;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+    }
+    rng.seed(seed);
+    printf("YuvConverterTest: seed %u, active kernel %s\n", seed, kernelName(activeKernel()));
+
+    for (Kernel kernel : kKernels) {
+        if (!isSupported(kernel)) {
+            printf("  %-6s not supported on this CPU, skipped\n", kernelName(kernel));
+            continue;
+        }
+        const int before = failures;
+        int cases = testConvert(kernel);
+        cases += testScaledConvert(kernel);
+        cases += testScalePlanes(kernel);
+        cases += testNarrow(kernel);
+        printf("  %-6s %d cases, %s\n", kernelName(kernel), cases, failures == before ? "bit-exact" : "MISMATCH");
+    }
+
+    if (failures) {
+        printf("%d mismatching case(s)\n", failures);
+        return 1;
+    }
+    return 0;
+}
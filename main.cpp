@@ -8,6 +8,7 @@
 #include "Medium.h"
 #include "VLCPlayerHandler.h"  
 #include "Navigator.h"
+#include "VlcInstance.h"
 
 #ifdef Q_OS_WIN
 #include <winsock2.h>
@@ -81,6 +82,8 @@ int main(int argc, char* argv[]) {
     QGuiApplication::setHighDpiScaleFactorRoundingPolicy(Qt::HighDpiScaleFactorRoundingPolicy::Round);
 
     QGuiApplication app(argc, argv);
+    // Load libVLC's plugins while the UI starts, not when a player opens.
+    VlcInstance::warmUp();
     app.setWindowIcon(QIcon(":/logo.ico"));
     // Set application style to "Fusion"
     QQuickStyle::setStyle("Fusion");
@@ -111,6 +114,7 @@ int main(int argc, char* argv[]) {
         return -1;
 
     int result = app.exec();
+    VlcInstance::shutdown();
 
 #ifdef Q_OS_WIN
     WSACleanup();